@@ -6,7 +6,8 @@
 ; address 0x0000:0x7C00 and transfers control to `start` in 16-bit real mode.
 ;
 ; Boot-time behavior:
-;   1) Establishes a deterministic 16-bit execution context (segments + stack).
+;   1) Establishes a deterministic 16-bit execution context (segments + stack)
+;      and moves itself from 0x7C00 to 0x0600, out of the kernel's load range.
 ;   2) Uses BIOS interrupt services to print status and read kernel sectors.
 ;   3) Verifies disk I/O success and jumps to the loaded kernel image at 0x1000.
 ;   4) If any stage fails, halts safely in-place.
@@ -16,10 +17,13 @@
 ;     the kernel, this code is effectively dead unless a reset occurs.
 ;
 ; Memory model and layout:
-;   - Boot sector image occupies 512 bytes at physical 0x7C00..0x7DFF.
+;   - BIOS loads the sector at 0x7C00; it copies itself to 0x0600..0x07FF
+;     (ORG below) so kernel sectors may be loaded over 0x7C00.
 ;   - BOOT_DRIVE and string literals live inside that region.
-;   - Kernel payload is loaded at physical 0x1000 (ES:BX = 0x0000:0x1000).
-;   - Stack starts at SS:SP = 0x0000:0x7C00 and grows downward.
+;   - Kernel payload is loaded at physical 0x1000 (ES:BX = 0x0000:0x1000)
+;     and may extend up to the kernel stack at 0xB000..0xBFFF.
+;   - Stack starts at SS:SP = 0x0000:0xC000 (the kernel's stack top) and grows
+;     downward, clear of both the kernel image and this code.
 ;
 ; CPU-level implications:
 ;   - Real mode: 20-bit segmented addressing, no paging/protection/isolation.
@@ -29,11 +33,11 @@
 ;     and consume registers according to BIOS ABI conventions.
 ;
 ; Limitations and edge cases:
-;   - CHS read parameters are hard-coded and assume a BIOS geometry-compatible
-;     disk image where kernel occupies sectors 2..11 on cylinder/head 0.
+;   - CHS geometry is hard-coded for a 1.44MB floppy image (18 sectors per
+;     track, 2 heads); the kernel starts at LBA 1 (cylinder 0, head 0, sector 2).
+;   - KERNEL_SECTORS is supplied by the Makefile; the linker script asserts the
+;     kernel image (including .bss) fits inside that many sectors.
 ;   - No A20 enablement, no protected-mode transition, no filesystem parsing.
-;   - If kernel exceeds 10 sectors, load truncation occurs silently unless AL
-;     mismatch or carry flag catches failure.
 ;   - `jmp 0x1000` assumes code at 0x1000 is valid 16-bit entry code.
 ;
 ; Reference notes:
@@ -42,24 +46,43 @@
 ; ==============================================================================
 
 [BITS 16]
-[ORG 0x7C00]
+[ORG 0x0600]
 
+BIOS_LOAD_ADDRESS equ 0x7C00    ; Where the BIOS placed this sector.
 KERNEL_OFFSET equ 0x1000        ; Physical load destination for kernel image.
+BOOT_STACK_TOP equ 0xC000       ; Same stack top the kernel uses.
+SECTORS_PER_TRACK equ 18        ; 1.44MB floppy geometry.
+HEAD_COUNT equ 2
 
-start:
-    ; BIOS passes boot drive in DL. Persist it before any BIOS calls may clobber.
-    mov [BOOT_DRIVE], dl
+%ifndef KERNEL_SECTORS
+KERNEL_SECTORS equ 80           ; Default; normally passed in with -D by make.
+%endif
 
+start:
     ; Enter a known-good execution context.
     ; DS/ES/SS=0 means symbolic addresses resolve within low physical memory.
+    ; Nothing here may reference a label until the jump below: this code is
+    ; still running at BIOS_LOAD_ADDRESS, not at its ORG.
     cli
     xor ax, ax
     mov ds, ax
     mov es, ax
     mov ss, ax
-    mov sp, 0x7C00
+    mov sp, BOOT_STACK_TOP
     sti
 
+    ; Move this sector to its ORG and continue there (DL is preserved).
+    cld
+    mov si, BIOS_LOAD_ADDRESS
+    mov di, $$
+    mov cx, 256
+    rep movsw
+    jmp 0x0000:relocated
+
+relocated:
+    ; BIOS passes boot drive in DL. Persist it before any BIOS calls may clobber.
+    mov [BOOT_DRIVE], dl
+
     ; Progress telemetry through BIOS teletype output (INT 10h AH=0Eh).
     mov si, msg_boot
     call print
@@ -67,19 +90,22 @@ start:
     mov si, msg_loading
     call print
 
-    ; Configure BIOS CHS read:
-    ;   AH=0x02 (read sectors)
-    ;   AL=10 sectors
-    ;   CH=0 cylinder, CL=2 sector index (1-based), DH=0 head
-    ;   DL=boot drive
-    ; Destination buffer is ES:BX = 0x0000:0x1000.
+    ; Read the kernel one sector at a time with BIOS CHS reads:
+    ;   AH=0x02 (read sectors), AL=1 sector
+    ;   CH=cylinder, CL=sector index (1-based), DH=head, DL=boot drive
+    ; Destination buffer is ES:BX, starting at 0x0000:0x1000.
+    ; Single-sector reads never cross a track boundary, so the same loop works
+    ; on BIOSes that refuse multi-track transfers.
+    mov bx, KERNEL_OFFSET
+    mov word [sectors_left], KERNEL_SECTORS
+
+.read_loop:
     mov ah, 0x02
-    mov al, 10
-    mov ch, 0
-    mov cl, 2
-    mov dh, 0
+    mov al, 1
+    mov ch, [chs_cylinder]
+    mov cl, [chs_sector]
+    mov dh, [chs_head]
     mov dl, [BOOT_DRIVE]
-    mov bx, KERNEL_OFFSET
 
     int 0x13
 
@@ -87,9 +113,25 @@ start:
     jc disk_error
 
     ; Error path #2: short read. BIOS returns sectors transferred in AL.
-    cmp al, 10
+    cmp al, 1
     jne disk_error
 
+    ; Advance destination and CHS position (sector -> head -> cylinder).
+    add bx, 512
+    inc byte [chs_sector]
+    cmp byte [chs_sector], SECTORS_PER_TRACK + 1
+    jne .next_sector
+    mov byte [chs_sector], 1
+    inc byte [chs_head]
+    cmp byte [chs_head], HEAD_COUNT
+    jne .next_sector
+    mov byte [chs_head], 0
+    inc byte [chs_cylinder]
+
+.next_sector:
+    dec word [sectors_left]
+    jnz .read_loop
+
     mov si, msg_success
     call print
 
@@ -128,6 +170,10 @@ print:
 
 ; Data region: packed directly into the 512-byte boot sector footprint.
 BOOT_DRIVE:     db 0
+chs_cylinder:   db 0
+chs_head:       db 0
+chs_sector:     db 2            ; Kernel starts right after the boot sector.
+sectors_left:   dw 0
 msg_boot:       db "AnnotatOS Bootloader", 0x0D, 0x0A, 0
 msg_loading:    db "Loading kernel...", 0x0D, 0x0A, 0
 msg_success:    db "Kernel loaded, starting...", 0x0D, 0x0A, 0
@@ -9,311 +9,4055 @@
  * Boot-time behavior (as seen from this file):
  * 1) `kernel_main` is entered from `kernel_entry.asm` with flat real-mode
  *    segments (base 0) and a pre-positioned stack.
- * 2) Screen memory is cleared, a banner is printed, and shell loop starts.
+ * 2) Screen memory is cleared, a banner is printed, QEMU fw_cfg files named
+ *    `opt/...` are pulled into RAM (one DMA transfer each), an NE2000 at
+ *    0x300 is reset and started if present, and the shell loop starts.
  *
  * Runtime behavior:
- * 1) Poll keyboard controller status/data ports for Set-1 make codes.
- * 2) Translate scancodes into ASCII subset.
- * 3) Mutate in-memory command buffer and VGA memory for TTY-like interaction.
+ * 1) Sleep in `hlt` until IRQ1 (keyboard) or IRQ4 (COM1) fires, then drain
+ *    the device with its IRQ masked (a budgeted, NAPI-style poll), re-arming
+ *    interrupts only once input runs dry.
+ * 2) Translate scancodes / serial bytes into one stream of console characters.
+ * 3) Mutate in-memory command buffer and VGA memory for TTY-like interaction;
+ *    every console write is mirrored to COM1 so the shell can be driven
+ *    remotely (QEMU exposes COM1 as a telnet server with `make run-remote`).
  * 4) Dispatch built-in commands and return to prompt indefinitely.
  *
  * Memory behavior and data layout:
  * - `vga_buffer` maps physical 0xB8000 where each cell is 16 bits:
- *   [attribute byte | ASCII byte].
- * - `cursor_x`/`cursor_y` are global scalar state in `.data` or `.bss`.
+ *   [attribute byte | ASCII byte]. When the CPU allows it, a fixed-range
+ *   MTRR makes that window write-combining; `vga_flush` (SFENCE) marks the
+ *   frame boundaries where buffered stores must reach the screen.
+ * - Console text is drawn into a shadow screen at CONSOLE_SHADOW_BASE and
+ *   copied to `vga_buffer` at most once per CONSOLE_FRAME_MS while output
+ *   streams, and whenever the console goes idle; bulk output scrolls RAM.
+ * - `cursor_x`/`cursor_y` are per-CPU variables in `.percpu`, reached with
+ *   `this_cpu()` relative to FS (FS base = this CPU's copy of the section).
  * - `command_buffer` is a fixed-size stack array in `shell_run`; lifetime is
  *   per-loop-iteration and capacity is bounded by COMMAND_BUFFER_SIZE.
- * - No allocator, paging, virtual memory, or process isolation exists.
+ * - RAM files: a fixed table of {name, address, size} records whose data is
+ *   bump-allocated from physical RAMFS_BASE..RAMFS_LIMIT and never freed.
+ *   That window lies above 64KB; like `vga_buffer`, it is reached with
+ *   32-bit offsets from DS=0, which QEMU accepts in real mode.
+ * - Pipe: `cmd1 | cmd2` collects cmd1's console output as a list of
+ *   {address, length} segments. Text is copied into PIPE_BUFFER_BASE, but
+ *   `cat` hands a RAM file over as one segment pointing at its data.
+ * - Program window: `exec` loads ELF32 PT_LOAD segments into physical
+ *   PROGRAM_BASE..PROGRAM_LIMIT (below 64KB so code is reachable with CS=0)
+ *   and calls the entry point; programs return an exit status.
+ * - System calls: INT 80h through `syscall_stub` into `syscall_table`, with
+ *   a register ABI (EAX = number, EBX/ECX/EDX = args, EAX = result).
+ * - FPU/SSE: enabled at boot when CPUID reports SSE2 + FXSR. The SSE2
+ *   leaf routines (string search, memcpy_nt, print) use XMM registers
+ *   unbracketed. The IRQ1/IRQ4 stubs run no C code. The C behind INT 80h
+ *   (`syscall_dispatch`) is only entered synchronously, from `exec`
+ *   programs built without -msse or from kernel code between leaf calls,
+ *   and the #NM body (`fpu_nm_handler`) only saves the state. So nothing
+ *   holds XMM state live across them. Any other kernel code using FPU/SSE
+ *   registers brackets itself with kernel_fpu_begin/end, which saves the
+ *   interrupted state to FPU_SAVE_AREA eagerly or, lazily, only when the
+ *   #NM trap from CR0.TS shows the unit was really touched.
+ * - Network: frames move between the NE2000's on-card rings and a pool of
+ *   NET_BUFFER_COUNT buffers at NET_POOL_BASE. Each buffer keeps headroom so
+ *   UDP/IPv4/Ethernet headers are prepended in place, and a reference count
+ *   lets a received packet be resent (ICMP echo) or parked on an unresolved
+ *   ARP cache slot without copying. The card has no IRQ wired; the console
+ *   input loop polls it on every wake-up, at least once per BIOS timer tick.
+ * - Time page: TSC-to-nanosecond scale at TIME_PAGE_BASE, calibrated at
+ *   boot against the BIOS timer tick; programs read the clock directly.
+ * - Console ring: a program-to-kernel SPSC byte ring at CONSOLE_RING_BASE.
+ *   Programs write output there without a system call; the kernel prints it
+ *   on SYS_RING_WAIT (ring full), before any other console system call,
+ *   and when the program returns.
+ * - Submission/completion rings at URING_BASE: programs queue console
+ *   writes, RAM file opens/reads, and timeouts, then run a whole batch with
+ *   one SYS_URING_ENTER.
+ * - No general allocator, paging, virtual memory, or process isolation exists.
  *
  * CPU-level implications:
  * - Port I/O uses IN/OUT instructions (`inb`, `outw`) and therefore requires
  *   ring0-like unrestricted execution (naturally true in real mode).
- * - Busy-wait keyboard polling consumes CPU cycles continuously; there is no
- *   interrupt-driven sleep path for input readiness.
- * - `hlt` is used only in terminal states; main shell loop is active polling.
+ * - The IRQ1/IRQ4 vectors are replaced with stubs that only mask their IRQ;
+ *   the BIOS INT 09h handler never runs, so it cannot race the kernel for
+ *   bytes on port 0x60. Bursts of input cost one interrupt, not one each.
+ * - Serial console output is staged in a RAM buffer and drained in bursts of
+ *   SERIAL_FIFO_DEPTH bytes per transmitter-empty check, so the UART status
+ *   register is read once per 16 bytes instead of once per byte.
+ * - `hlt` is used when idle waiting for input and in terminal states.
  *
  * Data structures:
- * - VGA text buffer: conceptual 2D matrix [25 rows][80 cols], stored linearly
- *   as 2000 contiguous uint16_t entries in row-major order.
+ * - VGA text buffer: conceptual 2D matrix [vga_height][vga_width] (80x25 at
+ *   boot; 80x50 or 90x60 after `mode`), stored linearly as contiguous
+ *   uint16_t entries in row-major order. `mode` uses the video BIOS only to
+ *   reset to mode 03h and load its ROM 8x8 font.
  * - Command parser: null-terminated byte string in a 64-byte local array.
+ * - Keyboard receive ring: power-of-two byte ring of make codes filled by
+ *   `keyboard_poll` and consumed by the shell. Serial input needs no ring: the
+ *   UART's own receive FIFO holds bytes until the shell reads them.
+ * - Serial transmit buffer: linear byte array flushed whenever it fills and
+ *   whenever the shell goes idle waiting for input.
+ * - RAM files are filled either by fw_cfg at boot or by `recv` over COM1.
+ * - fw_cfg directory cache: the device's file list, read once at boot with
+ *   two DMA transfers and kept in host byte order.
+ * - Serial upload frames (host -> guest, see tools/sendfile.py):
+ *   [0x02][type][seq][length][payload...][CRC-16/CCITT hi][lo]; guest replies
+ *   are [0x02][type][seq & 0x7F]. Transfers use a go-back-N sliding window.
+ * - Telemetry records on COM2: [0xA5][type][payload length][payload...].
  *
  * Limitations and edge cases:
- * - No Shift/Ctrl state tracking; keyboard mapping is lowercase subset only.
+ * - Shift is tracked (US layout) but Ctrl/Alt/Caps Lock are not; the
+ *   keyboard mapping covers a subset of keys.
  * - Backspace is line-local and does not traverse to previous lines.
- * - String ops are minimal (`strcmp` only) and assume trusted in-kernel data.
+ * - String ops (strlen/strcmp/strncmp/strchr/memcmp) use SSE2 once
+ *   `alternatives_apply` patches it in and word-at-a-time code before that;
+ *   they assume trusted in-kernel data.
  * - Poweroff ports are emulator-specific and may not work on all machines.
+ * - Real mode has no privilege levels: INT 80h gives callers a stable ABI,
+ *   not protection. SYSENTER/SYSCALL and ring 3 need protected/long mode.
  * - Shell loop has no timeout or cooperative scheduling.
+ * - One CPU and no kernel preemption: IRQ stubs never touch C data, so the
+ *   RAM file table, fw_cfg cache, and dispatch tables are read lock-free
+ *   and updated in place (no RCU or atomics needed until SMP arrives).
  *
  * Reference hints:
  * - VGA text memory map: IBM VGA-compatible adapters (mode 03h semantics).
  * - Keyboard controller ports 0x64/0x60: classic i8042-compatible interface.
+ * - QEMU fw_cfg: docs/specs/fw_cfg.rst in the QEMU tree (DMA at port 0x514).
+ * - COM1 at 0x3F8 / COM2 at 0x2F8: National Semiconductor 16550A UART
+ *   register layout (16-byte transmit FIFO).
+ * - NE2000 at 0x300: National Semiconductor DP8390 register pages plus the
+ *   NE2000 data/reset ports (QEMU hw/net/ne2000.c).
  */
 
 /* VGA text mode memory base address (physical memory). */
 #define VGA_MEMORY 0xB8000
 
-/* Classic text mode dimensions. */
-#define VGA_WIDTH 80
-#define VGA_HEIGHT 25
+/* Shadow screen the console draws into (room for 90x60 cells). */
+#define CONSOLE_SHADOW_BASE 0x96000
+
+/* Longest the visible screen may lag the shadow during output (~30 fps). */
+#define CONSOLE_FRAME_MS 33
+
+/* VGA register ports (color I/O addresses) and the CRTC registers per mode. */
+#define VGA_MISC_WRITE 0x3C2
+#define VGA_SEQ_INDEX 0x3C4
+#define VGA_SEQ_DATA 0x3C5
+#define VGA_CRTC_INDEX 0x3D4
+#define VGA_CRTC_DATA 0x3D5
+#define VGA_AC_WRITE 0x3C0         /* Attribute controller: index, then data. */
+#define VGA_INPUT_STATUS 0x3DA     /* Reading it resets the AC index/data flip-flop. */
+#define VGA_AC_PEL_PANNING 0x13
+#define VGA_AC_PAS 0x20            /* Keep the palette on (display enabled). */
+#define VGA_CRTC_COUNT 25
+#define VGA_CRTC_PROTECT 0x80      /* CRTC 0x11 bit 7: registers 0-7 read-only. */
+#define VGA_TEXT_MODE_COUNT 3
 
 /* PS/2 keyboard controller I/O ports. */
 #define KEYBOARD_STATUS_PORT 0x64
 #define KEYBOARD_DATA_PORT 0x60
 
-/* Shell command buffer size (characters per input line). */
-#define COMMAND_BUFFER_SIZE 64
+/* Master 8259 PIC data port (interrupt mask register) and the IRQ1 bit. */
+#define PIC1_DATA_PORT 0x21
+#define PIC_IRQ1_KEYBOARD 0x02
+
+/* Real-mode interrupt vectors used by IRQ1/IRQ4 with the BIOS PIC layout. */
+#define KEYBOARD_IRQ_VECTOR 0x09
+#define SERIAL_IRQ_VECTOR 0x0C
+#define PIC_IRQ4_SERIAL 0x10
+
+/* Real-mode interrupt vector for system calls. */
+#define SYSCALL_VECTOR 0x80
+
+/* System call numbers (index into `syscall_table`). */
+#define SYS_NOP 0
+#define SYS_WRITE 1                /* EBX = buffer, ECX = length. */
+#define SYS_READ_CHAR 2            /* Returns next console character. */
+#define SYS_RING_WAIT 3            /* Drain the console ring; returns free bytes. */
+#define SYS_URING_ENTER 4          /* Run queued submissions; returns count. */
+
+/*
+ * Console output ring shared with programs (physical address and data size,
+ * a power of two). Programs append without entering the kernel.
+ */
+#define CONSOLE_RING_BASE 0x90000
+#define CONSOLE_RING_SIZE 4096
+
+/* Submission/completion rings shared with programs (entries: power of two). */
+#define URING_BASE 0x93000
+#define URING_ENTRIES 16
+#define URING_ERROR 0xFFFFFFFF     /* CQE result for a failed operation. */
+
+/* Submission opcodes. */
+#define URING_OP_NOP 0
+#define URING_OP_WRITE 1           /* Console write: address, length. */
+#define URING_OP_OPEN 2            /* RAM file lookup: address = name. */
+#define URING_OP_READ 3            /* RAM file read: file, offset, address, length. */
+#define URING_OP_TIMEOUT 4         /* Sleep `length` BIOS ticks. */
+
+/* Program window for `exec` (the kernel stack sits just below, 0xB000..0xBFFF). */
+#define PROGRAM_BASE 0xC000
+#define PROGRAM_LIMIT 0x10000
+
+/* ELF32 constants used by the loader. */
+#define ELF_MAGIC 0x464C457F       /* "\x7FELF" read as little-endian u32. */
+#define ELF_CLASS_32 1
+#define ELF_DATA_LSB 1
+#define ELF_TYPE_EXEC 2
+#define ELF_MACHINE_386 3
+#define ELF_PT_LOAD 1
+#define ELF_PF_W 0x2
+
+/* Iterations timed by the `sysbench` and `fpubench` builtins. */
+#define SYSBENCH_ITERATIONS 1000
+#define FPUBENCH_ITERATIONS 1000
+
+/* Full-screen frames drawn per video memory type by the `bench` builtin. */
+#define BENCH_FRAMES 64
+
+/* Control register bits used to enable and guard the FPU/SSE unit. */
+#define CR0_MP 0x02                /* WAIT/FWAIT honour TS. */
+#define CR0_EM 0x04                /* Set = no FPU; SSE raises #UD. */
+#define CR0_TS 0x08                /* Set = next FPU/SSE use raises #NM. */
+#define CR0_NE 0x20                /* Report x87 errors as exceptions. */
+#define CR0_NW 0x20000000          /* Not write-through (kept clear). */
+#define CR0_CD 0x40000000          /* Cache disable, set while MTRRs change. */
+#define CR4_OSFXSR 0x200           /* OS uses FXSAVE/FXRSTOR; enables SSE. */
+#define CR4_OSXMMEXCPT 0x400       /* OS handles SIMD FP exceptions. */
+
+/* CPUID feature bits: leaf 1 EDX/ECX and leaf 7 (subleaf 0) EBX. */
+#define CPUID_EDX_MTRR 0x00001000
+#define CPUID_EDX_FXSR 0x01000000
+#define CPUID_EDX_SSE 0x02000000
+#define CPUID_EDX_SSE2 0x04000000
+#define CPUID_ECX_SSE42 0x00100000
+#define CPUID_ECX_POPCNT 0x00800000
+#define CPUID_EBX7_AVX2 0x00000020
+#define CPUID_EBX7_ERMS 0x00000200
+
+/* Kernel feature bits in `cpu_features`, in `cpu_feature_names` order. */
+#define CPU_FEATURE_SSE2 0x01      /* Set by fpu_init once SSE is enabled. */
+#define CPU_FEATURE_SSE42 0x02
+#define CPU_FEATURE_POPCNT 0x04
+#define CPU_FEATURE_ERMS 0x08      /* Fast REP MOVSB. */
+#define CPU_FEATURE_AVX2 0x10      /* Reported only: VEX code #UDs in real mode. */
+#define CPU_FEATURE_COUNT 5
+
+/* MTRR MSRs and the fixed-range byte that types VGA text memory. */
+#define MSR_MTRR_CAP 0x0FE
+#define MSR_MTRR_FIX16K_A0000 0x259  /* Eight 16KB ranges, 0xA0000-0xBFFFF. */
+#define MSR_MTRR_DEF_TYPE 0x2FF
+#define MTRR_CAP_FIXED 0x100
+#define MTRR_CAP_WC 0x400
+#define MTRR_DEF_FIXED_ENABLE 0x400
+#define MTRR_DEF_ENABLE 0x800
+#define MTRR_TYPE_UC 0x00
+#define MTRR_TYPE_WC 0x01
+#define MTRR_VGA_TEXT_SHIFT 48       /* Byte 6: 0xB8000-0xBBFFF. */
+
+/* #NM (device not available) vector and the 512-byte FXSAVE image. */
+#define FPU_NM_VECTOR 0x07
+#define FPU_SAVE_AREA 0x94000      /* Must be 16-byte aligned. */
+
+/* Interactive console UART (COM1), telemetry UART (COM2), register offsets. */
+#define SERIAL_PORT 0x3F8
+#define TELEMETRY_PORT 0x2F8
+#define SERIAL_DATA 0          /* RBR (read) / THR (write); DLL when DLAB=1. */
+#define SERIAL_IER 1           /* Interrupt enable; DLM when DLAB=1. */
+#define SERIAL_FCR 2           /* FIFO control (write only). */
+#define SERIAL_LCR 3           /* Line control; bit 7 = DLAB. */
+#define SERIAL_MCR 4           /* Modem control; OUT2 gates the IRQ line. */
+#define SERIAL_LSR 5           /* Line status. */
+#define SERIAL_LSR_DATA_READY 0x01
+#define SERIAL_LSR_THR_EMPTY 0x20
+
+/* 115200 / SERIAL_BAUD_DIVISOR = line rate (1 -> 115200 baud). */
+#define SERIAL_BAUD_DIVISOR 1
+
+/* Bytes the 16550A accepts back-to-back once THR-empty is reported. */
+#define SERIAL_FIFO_DEPTH 16
+
+/* Console transmit staging buffer size. */
+#define SERIAL_TX_BUFFER_SIZE 256
+
+/* Telemetry record framing. */
+#define TELEMETRY_MAGIC 0xA5
+#define TELEMETRY_COMMAND 0x01     /* Payload: u64 TSC cycles + command text. */
+
+/* Keyboard receive ring capacity (power of two) and per-poll drain budget. */
+#define KEYBOARD_RING_SIZE 16
+#define KEYBOARD_POLL_BUDGET 8
+
+/* Set-1 scancodes for the Shift keys, and the release bit. */
+#define KEYBOARD_LEFT_SHIFT 0x2A
+#define KEYBOARD_RIGHT_SHIFT 0x36
+#define KEYBOARD_RELEASE 0x80
+
+/* Shell command buffer size (characters per input line). */
+#define COMMAND_BUFFER_SIZE 64
+
+/* RAM file table: capacity, name length, table address, and data window. */
+#define RAM_FILE_MAX 16
+#define RAM_FILE_NAME_SIZE 56
+#define RAM_FILE_TABLE_BASE 0x95800
+#define RAMFS_BASE 0x20000
+#define RAMFS_LIMIT 0x80000
+
+/* Pipe between two builtins: segment table size and copy-buffer window. */
+#define PIPE_SEGMENT_MAX 32
+#define PIPE_BUFFER_BASE 0x80000
+#define PIPE_BUFFER_LIMIT 0x90000
+
+/* QEMU fw_cfg I/O ports (selector, data, big-endian DMA address pair). */
+#define FWCFG_SELECTOR_PORT 0x510
+#define FWCFG_DATA_PORT 0x511
+#define FWCFG_DMA_HIGH_PORT 0x514
+#define FWCFG_DMA_LOW_PORT 0x518
+
+/* fw_cfg items and feature bits. */
+#define FWCFG_SIGNATURE 0x0000
+#define FWCFG_ID 0x0001
+#define FWCFG_FILE_DIR 0x0019
+#define FWCFG_FEATURE_DMA 0x02
+
+/* Directory entries cached at boot (QEMU's default file slot count). */
+#define FWCFG_DIR_CACHE_MAX 32
+#define FWCFG_DIR_CACHE_BASE 0x95000
+
+/* BIOS Data Area timer tick counter (18.2 Hz, maintained by BIOS IRQ0). */
+#define BIOS_TICK_COUNT 0x46C
+#define BIOS_TICKS_PER_10S 182
+
+/* One BIOS tick (65536 PIT input clocks at 1.193182 MHz) in nanoseconds. */
+#define BIOS_TICK_NS 54925439
+
+/* Time page shared with programs, TSC calibration length, scale shift. */
+#define TIME_PAGE_BASE 0x92000
+#define TIME_CALIBRATION_TICKS 2
+#define TIME_SHIFT 24
+
+/* Serial upload framing; must match tools/sendfile.py. */
+#define RECV_SYNC 0x02
+#define RECV_FRAME_START 'S'       /* Payload: u32 little-endian file size. */
+#define RECV_FRAME_DATA 'D'
+#define RECV_FRAME_END 'E'
+#define RECV_REPLY_READY 'R'
+#define RECV_REPLY_ACK 'A'         /* Cumulative: every frame <= seq is held. */
+#define RECV_REPLY_NAK 'N'         /* Resend starting at seq. */
+#define RECV_REPLY_FAIL 'F'
+#define RECV_PAYLOAD_MAX 128
+#define RECV_TIMEOUT_TICKS 91      /* ~5 seconds of silence aborts. */
+
+/* fw_cfg DMA control bits. */
+#define FWCFG_DMA_ERROR 0x01
+#define FWCFG_DMA_READ 0x02
+#define FWCFG_DMA_SELECT 0x08
+
+/* NE2000 (QEMU -nic user,model=ne2k_isa) I/O base and DP8390 registers, page 0. */
+#define NE2K_BASE 0x300
+#define NE2K_COMMAND 0x00          /* CR: same offset on every register page. */
+#define NE2K_PAGE_START 0x01
+#define NE2K_PAGE_STOP 0x02
+#define NE2K_BOUNDARY 0x03
+#define NE2K_TX_PAGE 0x04
+#define NE2K_TX_COUNT 0x05         /* Low byte; high byte at the next port. */
+#define NE2K_ISR 0x07
+#define NE2K_DMA_ADDRESS 0x08      /* Low byte; high byte at the next port. */
+#define NE2K_DMA_COUNT 0x0A        /* Low byte; high byte at the next port. */
+#define NE2K_RX_CONFIG 0x0C
+#define NE2K_TX_CONFIG 0x0D
+#define NE2K_DATA_CONFIG 0x0E
+#define NE2K_IMR 0x0F
+#define NE2K_STATION 0x01          /* Page 1: MAC address, six ports. */
+#define NE2K_CURRENT 0x07          /* Page 1: next receive page the card fills. */
+#define NE2K_DATA 0x10             /* Remote DMA data port. */
+#define NE2K_RESET 0x1F            /* Reading it resets the card. */
+
+/* NE2000 command, interrupt status and configuration bits. */
+#define NE2K_CR_STOP 0x01
+#define NE2K_CR_START 0x02
+#define NE2K_CR_TRANSMIT 0x04
+#define NE2K_CR_DMA_READ 0x08
+#define NE2K_CR_DMA_WRITE 0x10
+#define NE2K_CR_NO_DMA 0x20
+#define NE2K_CR_PAGE1 0x40
+#define NE2K_ISR_TX 0x02
+#define NE2K_ISR_TX_ERROR 0x08
+#define NE2K_ISR_DMA_DONE 0x40
+#define NE2K_DCR_BYTE_NORMAL 0x48  /* Byte-wide DMA, no loopback, 8-byte FIFO. */
+#define NE2K_RCR_BROADCAST 0x04
+
+/* NE2000 on-card memory (256-byte pages): transmit buffer, then receive ring. */
+#define NE2K_TX_START 0x40
+#define NE2K_RX_START 0x46
+#define NE2K_RX_STOP 0x80
+
+/* Packet buffer pool: count, bytes per buffer, room kept for prepended headers. */
+#define NET_BUFFER_COUNT 16
+#define NET_BUFFER_SIZE 1536
+#define NET_BUFFER_HEADROOM 64
+#define NET_POOL_BASE 0x99000
+
+/* ARP neighbour cache slots (power of two, indexed by an address hash). */
+#define NET_NEIGHBOUR_COUNT 8
+
+/* QEMU user-network addresses, stored in network byte order. */
+#define NET_IP(a, b, c, d) \
+    ((uint32_t)(a) | (uint32_t)(b) << 8 | (uint32_t)(c) << 16 | (uint32_t)(d) << 24)
+#define NET_GUEST_IP NET_IP(10, 0, 2, 15)
+#define NET_GATEWAY_IP NET_IP(10, 0, 2, 2)
+#define NET_SUBNET_MASK NET_IP(255, 255, 255, 0)
+
+/* Ethernet types and sizes, ARP operations, IPv4 protocols, ICMP types. */
+#define ETH_TYPE_IPV4 0x0800
+#define ETH_TYPE_ARP 0x0806
+#define ETH_FRAME_MIN 60
+#define ARP_HARDWARE_ETHERNET 1
+#define ARP_REQUEST 1
+#define ARP_REPLY 2
+#define IP_PROTOCOL_ICMP 1
+#define IP_PROTOCOL_UDP 17
+#define IP_FRAGMENT_MASK 0x3FFF    /* More-fragments flag and offset. */
+#define ICMP_ECHO_REPLY 0
+#define ICMP_ECHO_REQUEST 8
+
+/* Reply wait for `net`/`udpbench`, and the benchmark's datagrams and ports. */
+#define NET_TIMEOUT_TICKS 9        /* ~0.5 s. */
+#define NET_BENCH_PACKETS 1000
+#define NET_BENCH_PAYLOAD 64
+#define NET_BENCH_PORT 7777        /* tools/udp_echo.py, reached as 10.0.2.2. */
+#define NET_LOCAL_PORT 4000
+
+/* Basic fixed-width integer types (no libc available in freestanding kernel). */
+typedef unsigned char uint8_t;
+typedef unsigned short uint16_t;
+typedef unsigned int uint32_t;
+typedef unsigned long long uint64_t;
+
+/*
+ * Word-at-a-time string helpers: HAS_ZERO_BYTE(w) is nonzero iff some byte
+ * of w is 0; *_PAGE_CROSS(p) is true when a 4- or 16-byte load at p would
+ * run into the next 4KB page.
+ */
+#define WORD_ONES 0x01010101u
+#define HAS_ZERO_BYTE(w) (((w) - WORD_ONES) & ~(w) & 0x80808080u)
+#define WORD_PAGE_CROSS(p) (((uint32_t)(p) & 4095) > 4096 - 4)
+#define SSE2_PAGE_CROSS(p) (((uint32_t)(p) & 4095) > 4096 - 16)
+
+/*
+ * memcpy_nt switches to MOVNTDQ streaming stores from this many bytes up;
+ * below it the alignment head/tail and the closing SFENCE cost more than
+ * the cache lines saved.
+ */
+#define MEMCPY_NT_THRESHOLD 1024
+
+/* SSE2 vectors (16 bytes, 2 quadwords), and the attributes for functions that use them. */
+typedef char v16qi __attribute__((vector_size(16)));
+typedef long long v2di __attribute__((vector_size(16)));
+#define SSE2_FUNCTION __attribute__((target("sse2"), force_align_arg_pointer))
+
+/*
+ * Boot-time code patching. ALTERNATIVE(function, replacement, feature) adds
+ * an entry to the `.alternatives` section; `alternatives_apply` rewrites the
+ * first bytes of `function` into a jump to `replacement` when the CPU has
+ * `feature`. Callers keep calling `function` directly, with no per-call
+ * feature test or function pointer. Later entries for a function win.
+ * Every patched `function` is PATCHABLE, so that the compiler neither
+ * inlines it nor specializes callers on its body: each call must reach the
+ * bytes that get rewritten.
+ */
+struct alternative {
+    void* function;
+    void* replacement;
+    uint32_t feature;
+};
+
+#define PATCHABLE __attribute__((noinline, noipa))
+
+#define ALTERNATIVE(function, replacement, feature)                                  \
+    static const struct alternative alternative_##replacement                         \
+        __attribute__((section(".alternatives"), used)) = {                           \
+            (void*)(function), (void*)(replacement), (feature)}
+
+/* Bounds of the `.alternatives` table (defined in linker.ld). */
+extern const struct alternative __alternatives_start[];
+extern const struct alternative __alternatives_end[];
+
+/*
+ * Per-CPU variables. PERCPU places a variable in the `.percpu` section
+ * (cache-line aligned in linker.ld); `this_cpu(var)` is an lvalue that
+ * reaches the running CPU's copy FS-relative, so each access is a single
+ * FS-prefixed instruction. `percpu_init` points FS at the boot CPU's copy.
+ */
+#define PERCPU __attribute__((section(".percpu")))
+#define this_cpu(var) \
+    (*(__seg_fs __typeof__(var)*)((uint32_t)&(var) - (uint32_t)__percpu_start))
+
+/* Bounds of the `.percpu` template (defined in linker.ld). */
+extern char __percpu_start[];
+extern char __percpu_end[];
+
+/*
+ * One file held in RAM. `address` is physical; data is not NUL-terminated.
+ */
+struct ram_file {
+    char name[RAM_FILE_NAME_SIZE];
+    uint32_t address;
+    uint32_t size;
+};
+
+/*
+ * One run of pipe data at a physical address. A segment either refers to
+ * bytes the writer already had in RAM (a RAM file handed over without
+ * copying) or to bytes copied into the pipe buffer.
+ */
+struct pipe_segment {
+    uint32_t address;
+    uint32_t length;
+};
+
+/*
+ * fw_cfg file directory entry as stored by QEMU (size/select big-endian).
+ */
+struct fwcfg_file {
+    uint32_t size;
+    uint16_t select;
+    uint16_t reserved;
+    char name[RAM_FILE_NAME_SIZE];
+};
+
+/*
+ * fw_cfg DMA descriptor; all fields big-endian. The device reads it from the
+ * physical address written to the DMA ports and clears `control` when done.
+ */
+struct fwcfg_dma_access {
+    uint32_t control;
+    uint32_t length;
+    uint32_t address_high;
+    uint32_t address_low;
+};
+
+/*
+ * Registers saved by `syscall_stub` (PUSHAD order, lowest address first).
+ */
+struct syscall_frame {
+    uint32_t edi;
+    uint32_t esi;
+    uint32_t ebp;
+    uint32_t esp;
+    uint32_t ebx;
+    uint32_t edx;
+    uint32_t ecx;
+    uint32_t eax;
+};
+
+/*
+ * ELF32 file header (fields the loader checks or uses).
+ */
+struct elf32_header {
+    uint32_t magic;
+    uint8_t file_class;
+    uint8_t data;
+    uint8_t version;
+    uint8_t pad[9];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t elf_version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+};
+
+/*
+ * ELF32 program header.
+ */
+struct elf32_program_header {
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+};
+
+/*
+ * Text mode for the `mode` builtin. Every mode starts from the video BIOS
+ * (mode 03h, plus its ROM 8x8 font for 8-line modes, since the kernel
+ * carries no font); modes with `crtc` then get new timing and geometry.
+ */
+struct vga_text_mode {
+    const char* name;
+    uint8_t width;
+    uint8_t height;
+    uint8_t font_8x8;
+    uint8_t misc;              /* Miscellaneous output: clock, sync polarity. */
+    uint8_t clocking;          /* Sequencer clocking mode: bit 0 = 8-dot cells. */
+    const uint8_t* crtc;       /* CRTC 0x00-0x18, or 0 to keep the BIOS timing. */
+};
+
+/*
+ * Single-producer/single-consumer byte ring at CONSOLE_RING_BASE. The running
+ * program only writes `head`, the kernel only writes `tail`; each index has
+ * its own 64-byte cache line so the two sides never share a written line.
+ * Indices run freely and are masked with CONSOLE_RING_SIZE - 1 on access.
+ */
+struct console_ring {
+    volatile uint32_t head;
+    uint8_t head_pad[60];
+    volatile uint32_t tail;
+    uint8_t tail_pad[60];
+    uint8_t data[CONSOLE_RING_SIZE];
+};
+
+/*
+ * Clock parameters at TIME_PAGE_BASE, readable by programs without a system
+ * call: ns = ns_base + ((tsc - tsc_base) * mult >> shift). The kernel makes
+ * `seq` odd while it rewrites the fields; readers retry on an odd or
+ * changed `seq`.
+ */
+struct time_page {
+    volatile uint32_t seq;
+    uint32_t mult;
+    uint32_t shift;
+    uint32_t tsc_khz;
+    uint64_t tsc_base;
+    uint64_t ns_base;
+};
+
+/*
+ * One queued operation (see URING_OP_*). `user_data` is copied to the
+ * matching completion so the program can tell completions apart.
+ */
+struct uring_sqe {
+    uint8_t opcode;
+    uint8_t reserved;
+    uint16_t file;
+    uint32_t offset;
+    uint32_t address;
+    uint32_t length;
+    uint32_t user_data;
+};
+
+/* One finished operation: bytes transferred, file index, or URING_ERROR. */
+struct uring_cqe {
+    uint32_t user_data;
+    uint32_t result;
+};
+
+/*
+ * Submission and completion rings at URING_BASE. The program produces at
+ * `sq_tail` and consumes at `cq_head`; the kernel consumes at `sq_head` and
+ * produces at `cq_tail`. Each index has its own 64-byte line and indices run
+ * freely, masked with URING_ENTRIES - 1.
+ */
+struct uring {
+    volatile uint32_t sq_head;
+    uint8_t sq_head_pad[60];
+    volatile uint32_t sq_tail;
+    uint8_t sq_tail_pad[60];
+    volatile uint32_t cq_head;
+    uint8_t cq_head_pad[60];
+    volatile uint32_t cq_tail;
+    uint8_t cq_tail_pad[60];
+    struct uring_sqe sqes[URING_ENTRIES];
+    struct uring_cqe cqes[URING_ENTRIES];
+};
+
+/*
+ * Network headers as they appear on the wire: multi-byte fields are
+ * big-endian, and IPv4 addresses stay in network byte order throughout.
+ */
+struct eth_header {
+    uint8_t destination[6];
+    uint8_t source[6];
+    uint16_t type;
+} __attribute__((packed));
+
+struct arp_packet {
+    uint16_t hardware_type;
+    uint16_t protocol_type;
+    uint8_t hardware_size;
+    uint8_t protocol_size;
+    uint16_t operation;
+    uint8_t sender_mac[6];
+    uint32_t sender_ip;
+    uint8_t target_mac[6];
+    uint32_t target_ip;
+} __attribute__((packed));
+
+struct ipv4_header {
+    uint8_t version_ihl;
+    uint8_t tos;
+    uint16_t length;
+    uint16_t id;
+    uint16_t fragment;
+    uint8_t ttl;
+    uint8_t protocol;
+    uint16_t checksum;
+    uint32_t source;
+    uint32_t destination;
+};
+
+struct icmp_echo {
+    uint8_t type;
+    uint8_t code;
+    uint16_t checksum;
+    uint16_t id;
+    uint16_t sequence;
+};
+
+struct udp_header {
+    uint16_t source_port;
+    uint16_t destination_port;
+    uint16_t length;
+    uint16_t checksum;
+};
+
+/*
+ * Packet buffer from the pool at NET_POOL_BASE. `data` starts
+ * NET_BUFFER_HEADROOM bytes into the buffer so each layer can prepend its
+ * header in place. `refs` counts holders; 0 means free.
+ */
+struct net_buffer {
+    uint8_t* data;
+    uint16_t length;
+    uint8_t refs;
+};
+
+/*
+ * ARP cache slot. `pending` holds (a reference to) the latest packet sent
+ * to `ip` while its MAC address is still unknown.
+ */
+struct neighbour {
+    uint32_t ip;
+    uint8_t mac[6];
+    uint8_t resolved;
+    struct net_buffer* pending;
+};
+
+/* System call handler: three register arguments in, EAX result out. */
+typedef uint32_t (*syscall_handler)(uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+/* VGA buffer pointer. Each cell = [color:8 bits][ASCII char:8 bits]. */
+static uint16_t* vga_buffer = (uint16_t*)VGA_MEMORY;
+
+/* Text mode dimensions: mode 03h at boot, changed by the `mode` builtin. */
+static int vga_width = 80;
+static int vga_height = 25;
+
+/* 90x60 timing: 720x480 from the 28 MHz clock, 8-dot by 8-line cells. */
+static const uint8_t vga_crtc_90x60[VGA_CRTC_COUNT] = {
+    0x6B, 0x59, 0x5A, 0x82, 0x60, 0x8D, 0x0B, 0x3E,
+    0x00, 0x47, 0x06, 0x07, 0x00, 0x00, 0x00, 0x00,
+    0xEA, 0x0C, 0xDF, 0x2D, 0x08, 0xE8, 0x05, 0xA3,
+    0xFF,
+};
+
+static const struct vga_text_mode vga_text_modes[VGA_TEXT_MODE_COUNT] = {
+    {"80x25", 80, 25, 0, 0, 0, 0},
+    {"80x50", 80, 50, 1, 0, 0, 0},
+    {"90x60", 90, 60, 1, 0xE7, 0x01, vga_crtc_90x60},
+};
+
+/*
+ * Console cells are drawn into `console_shadow`; console_render copies it
+ * to `vga_buffer` and stamps `console_frame_tsc`.
+ */
+static uint16_t* const console_shadow = (uint16_t*)CONSOLE_SHADOW_BASE;
+static uint64_t console_frame_tsc = 0;
+
+/* Cursor location in text mode coordinates (per-CPU console state). */
+static PERCPU int cursor_x = 0;
+static PERCPU int cursor_y = 0;
+
+/*
+ * Keyboard receive ring. `keyboard_poll` produces at `head`, the shell
+ * consumes at `tail`; both wrap with KEYBOARD_RING_SIZE - 1.
+ */
+static uint8_t keyboard_ring[KEYBOARD_RING_SIZE];
+static uint8_t keyboard_ring_head = 0;
+static uint8_t keyboard_ring_tail = 0;
+
+/* Nonzero while a Shift key is held (tracked as the ring is consumed). */
+static int keyboard_shift = 0;
+
+/* Nonzero once COM1/COM2 passed their loopback self-test in `serial_init`. */
+static int serial_present = 0;
+static int telemetry_present = 0;
+
+/* Console bytes staged for COM1; drained by `serial_flush`. */
+static uint8_t serial_tx_buffer[SERIAL_TX_BUFFER_SIZE];
+static int serial_tx_length = 0;
+
+/* Last raw serial byte, used to fold CR LF / CR NUL into a single Enter. */
+static uint8_t serial_last_byte = 0;
+
+/*
+ * RAM file table (RAM_FILE_MAX entries at a fixed physical address, outside
+ * the kernel image) and the next free byte of the RAMFS window.
+ */
+static struct ram_file* const ram_files = (struct ram_file*)RAM_FILE_TABLE_BASE;
+static int ram_file_count = 0;
+static uint32_t ramfs_next = RAMFS_BASE;
+
+/*
+ * RAM file whose read-only segments currently occupy the program window.
+ * Re-running it reloads only writable segments; text is reused in place.
+ */
+static struct ram_file* program_resident = 0;
+
+/*
+ * `cmd1 | cmd2` state. While `pipe_capturing` is set, console output is
+ * appended to the pipe instead of the screen; the second command then reads
+ * the segments back in order with `pipe_read_char`.
+ */
+static struct pipe_segment pipe_segments[PIPE_SEGMENT_MAX];
+static int pipe_segment_count = 0;
+static uint32_t pipe_buffer_next = PIPE_BUFFER_BASE;
+static int pipe_capturing = 0;
+static int pipe_reading = 0;
+static int pipe_read_segment = 0;
+static uint32_t pipe_read_offset = 0;
+static int pipe_overflowed = 0;
+
+/* Console ring shared with `exec` programs (see struct console_ring). */
+static struct console_ring* const console_ring = (struct console_ring*)CONSOLE_RING_BASE;
+
+/* Clock parameters shared with `exec` programs (see struct time_page). */
+static struct time_page* const time_page = (struct time_page*)TIME_PAGE_BASE;
+
+/* Submission/completion rings shared with `exec` programs. */
+static struct uring* const uring = (struct uring*)URING_BASE;
+
+/*
+ * FPU/SSE state: `fpu_present` once SSE2 + FXSR are enabled, `fpu_lazy`
+ * selects the kernel_fpu_begin policy, and `fpu_saved` records whether the
+ * interrupted FPU state sits in FPU_SAVE_AREA (set by the #NM handler).
+ */
+static int fpu_present = 0;
+static int fpu_lazy = 1;
+static volatile int fpu_saved = 0;
+
+/* CPU_FEATURE_* bits found by cpu_detect, and alternatives patched in. */
+static uint32_t cpu_features = 0;
+static int alternatives_applied = 0;
+
+/*
+ * Video memory type: `vga_mtrr_present` when the fixed-range MTRRs can
+ * mark 0xB8000 write-combining, `vga_write_combining` while they do.
+ */
+static int vga_mtrr_present = 0;
+static int vga_write_combining = 0;
+
+/* Nonzero when QEMU fw_cfg with DMA support was detected. */
+static int fwcfg_dma_present = 0;
+
+/*
+ * fw_cfg directory snapshot taken once at boot into FWCFG_DIR_CACHE_MAX
+ * entries at a fixed physical address. The directory is fixed for the life
+ * of the VM, so `fwcfg ls` and lookups never go back to the device.
+ */
+static struct fwcfg_file* const fwcfg_directory = (struct fwcfg_file*)FWCFG_DIR_CACHE_BASE;
+static int fwcfg_directory_count = 0;
+static uint32_t fwcfg_directory_total = 0;
+
+/* NE2000 MAC address from the station PROM; valid once `ne2k_present`. */
+static uint8_t ne2k_mac[6];
+static int ne2k_present = 0;
+
+/* Packet buffer descriptors (data lives at NET_POOL_BASE) and the ARP cache. */
+static struct net_buffer net_buffers[NET_BUFFER_COUNT];
+static struct neighbour net_neighbours[NET_NEIGHBOUR_COUNT];
+static const uint8_t net_broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static const uint8_t net_unknown_mac[6] = {0};
+
+/* Next IPv4 identification, and replies seen: ICMP echo, UDP to NET_LOCAL_PORT. */
+static uint16_t net_ip_id = 0;
+static uint32_t net_echo_replies = 0;
+static uint32_t net_udp_received = 0;
+
+/* IRQ handlers in kernel_entry.asm: mask their IRQ and acknowledge the PIC. */
+extern void keyboard_irq_stub(void);
+extern void serial_irq_stub(void);
+extern void syscall_stub(void);
+extern void fpu_nm_stub(void);
+
+/* Defined with the string helpers; the screen code scrolls and renders with them. */
+void* memcpy(void* dst, const void* src, uint32_t length);
+void* memcpy_nt(void* dst, const void* src, uint32_t length);
+void* memmove(void* dst, const void* src, uint32_t length);
+
+/* Defined with the network stack; the console input loop polls the NIC. */
+static void net_poll(void);
+
+/* -------------------------------------------------------------------------- */
+/* Low-level I/O helpers                                                      */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Read one byte from an I/O port.
+ */
+static uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ __volatile__("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+/**
+ * Write one byte to an I/O port.
+ */
+static void outb(uint16_t port, uint8_t value) {
+    __asm__ __volatile__("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+/**
+ * Write one 16-bit word to an I/O port.
+ */
+static void outw(uint16_t port, uint16_t value) {
+    __asm__ __volatile__("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+/**
+ * Write one 32-bit doubleword to an I/O port.
+ */
+static void outl(uint16_t port, uint32_t value) {
+    __asm__ __volatile__("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+/**
+ * Reverse byte order of a 32-bit value (fw_cfg structures are big-endian).
+ */
+static uint32_t bswap32(uint32_t value) {
+    __asm__("bswap %0" : "+r"(value));
+    return value;
+}
+
+/**
+ * Point a real-mode interrupt vector at a handler in the kernel image.
+ *
+ * Each IVT entry is two 16-bit words at physical vector*4: [offset][segment].
+ * The kernel runs with CS=0, so the segment is 0. Callers mask interrupts.
+ */
+static void ivt_set_vector(uint8_t vector, void (*handler)(void)) {
+    volatile uint16_t* ivt_entry = (volatile uint16_t*)((unsigned int)vector * 4);
+
+    ivt_entry[0] = (uint16_t)(unsigned int)handler;
+    ivt_entry[1] = 0;
+}
+
+/**
+ * Point FS at this CPU's copy of `.percpu`. The boot CPU uses the section
+ * image itself; a second CPU would get its own copy of the same bytes and
+ * load that copy's paragraph instead. Must run before any `this_cpu()`.
+ */
+static void percpu_init(void) {
+    uint16_t segment = (uint16_t)((uint32_t)__percpu_start >> 4);
+
+    __asm__ __volatile__("mov %0, %%fs" : : "r"(segment));
+}
+
+/**
+ * Execute CPUID for `leaf` (subleaf 0); regs = {EAX, EBX, ECX, EDX}.
+ */
+static void cpuid(uint32_t leaf, uint32_t regs[4]) {
+    __asm__ __volatile__("cpuid"
+                         : "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+                         : "a"(leaf), "c"(0));
+}
+
+/**
+ * Read/write control registers CR0 and CR4 (allowed in real mode).
+ */
+static uint32_t read_cr0(void) {
+    uint32_t value;
+    __asm__ __volatile__("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static void write_cr0(uint32_t value) {
+    __asm__ __volatile__("mov %0, %%cr0" : : "r"(value));
+}
+
+static uint32_t read_cr4(void) {
+    uint32_t value;
+    __asm__ __volatile__("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static void write_cr4(uint32_t value) {
+    __asm__ __volatile__("mov %0, %%cr4" : : "r"(value));
+}
+
+/**
+ * Read the CPU timestamp counter (EDX:EAX).
+ */
+static uint64_t rdtsc(void) {
+    uint64_t value;
+    __asm__ __volatile__("rdtsc" : "=A"(value));
+    return value;
+}
+
+/**
+ * Read/write a model-specific register (EDX:EAX, index in ECX).
+ */
+static uint64_t rdmsr(uint32_t msr) {
+    uint64_t value;
+    __asm__ __volatile__("rdmsr" : "=A"(value) : "c"(msr));
+    return value;
+}
+
+static void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__("wrmsr" : : "c"(msr), "A"(value));
+}
+
+/**
+ * Call the video BIOS (INT 10h) with AX/BX. FS holds the per-CPU base and
+ * is not part of the BIOS contract, so it is saved around the call.
+ */
+static void bios_video(uint16_t ax, uint16_t bx) {
+    __asm__ __volatile__("pushw %%fs\n\tint $0x10\n\tpopw %%fs"
+                         : "+a"(ax), "+b"(bx)
+                         :
+                         : "ecx", "edx", "esi", "edi", "memory", "cc");
+}
+
+/**
+ * Halt the CPU forever.
+ * Used when we want to stop execution safely.
+ */
+static void halt_forever(void) {
+    while (1) {
+        __asm__ __volatile__("hlt");
+    }
+}
+
+/**
+ * Ask QEMU/Bochs-compatible power management ports to power off the VM.
+ * If unsupported, execution falls back to halting forever.
+ */
+static void qemu_poweroff(void) {
+    outw(0x604, 0x2000);  /* QEMU ACPI poweroff (common on i440fx machine). */
+    outw(0xB004, 0x2000); /* Bochs/older compatibility port. */
+    halt_forever();
+}
+
+/* -------------------------------------------------------------------------- */
+/* Serial console (COM1)                                                      */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Program one 16550 for 8N1 at 115200/SERIAL_BAUD_DIVISOR baud, FIFOs on.
+ *
+ * A loopback self-test guards against machines without that UART. Returns
+ * nonzero if the port answered; callers treat an absent port as a no-op sink.
+ */
+static int uart_init(uint16_t base) {
+    outb(base + SERIAL_IER, 0x00);
+    outb(base + SERIAL_LCR, 0x80);                        /* DLAB on. */
+    outb(base + SERIAL_DATA, SERIAL_BAUD_DIVISOR);
+    outb(base + SERIAL_IER, 0x00);
+    outb(base + SERIAL_LCR, 0x03);                        /* 8N1, DLAB off. */
+    outb(base + SERIAL_FCR, 0xC7);                        /* FIFOs on + clear. */
+
+    outb(base + SERIAL_MCR, 0x1E);                        /* Loopback test. */
+    outb(base + SERIAL_DATA, 0xAE);
+    if (inb(base + SERIAL_DATA) != 0xAE) {
+        return 0;
+    }
+
+    outb(base + SERIAL_MCR, 0x03);                        /* DTR|RTS. */
+    return 1;
+}
+
+/**
+ * Transmit a byte array, filling the whole transmit FIFO per THR-empty poll.
+ *
+ * THR-empty (LSR bit 5) with FIFOs enabled means the entire 16-byte FIFO is
+ * free, so one status read admits SERIAL_FIFO_DEPTH data writes.
+ */
+static void uart_write(uint16_t base, const uint8_t* data, int length) {
+    while (length > 0) {
+        int burst = length < SERIAL_FIFO_DEPTH ? length : SERIAL_FIFO_DEPTH;
+
+        while ((inb(base + SERIAL_LSR) & SERIAL_LSR_THR_EMPTY) == 0) {
+        }
+
+        length -= burst;
+        while (burst--) {
+            outb(base + SERIAL_DATA, *data++);
+        }
+    }
+}
+
+/**
+ * Bring up COM1 as the interactive console and COM2 as the telemetry stream.
+ * COM1's receive interrupt is routed to `serial_irq_stub` (IRQ4 starts
+ * masked); COM2 is transmit-only and never interrupts.
+ */
+static void serial_init(void) {
+    telemetry_present = uart_init(TELEMETRY_PORT);
+
+    if (!uart_init(SERIAL_PORT)) {
+        return;
+    }
+
+    __asm__ __volatile__("cli");
+    ivt_set_vector(SERIAL_IRQ_VECTOR, serial_irq_stub);
+    outb(PIC1_DATA_PORT, inb(PIC1_DATA_PORT) | PIC_IRQ4_SERIAL);
+    __asm__ __volatile__("sti");
+
+    outb(SERIAL_PORT + SERIAL_MCR, 0x0B);                 /* DTR|RTS|OUT2. */
+    outb(SERIAL_PORT + SERIAL_IER, 0x01);                 /* RX data IRQ. */
+    serial_present = 1;
+}
+
+/**
+ * Return nonzero if a received byte is waiting in the UART.
+ */
+static int serial_received(void) {
+    return serial_present && (inb(SERIAL_PORT + SERIAL_LSR) & SERIAL_LSR_DATA_READY);
+}
+
+/**
+ * Push all staged console bytes out of COM1.
+ */
+static void serial_flush(void) {
+    uart_write(SERIAL_PORT, serial_tx_buffer, serial_tx_length);
+    serial_tx_length = 0;
+}
+
+/**
+ * Stage one console byte for COM1, flushing when the buffer is full.
+ */
+static void serial_write_byte(uint8_t byte) {
+    if (!serial_present) {
+        return;
+    }
+
+    if (serial_tx_length == SERIAL_TX_BUFFER_SIZE) {
+        serial_flush();
+    }
+    serial_tx_buffer[serial_tx_length++] = byte;
+}
+
+/**
+ * Send a null-terminated string of raw bytes (used for terminal controls).
+ */
+static void serial_write_string(const char* str) {
+    while (*str) {
+        serial_write_byte((uint8_t)*str++);
+    }
+}
+
+/**
+ * Emit one framed telemetry record on COM2: header, then `length` payload
+ * bytes gathered from two pieces (fixed fields + variable text).
+ */
+static void telemetry_write(uint8_t type, const void* head, int head_length,
+                            const void* tail, int tail_length) {
+    uint8_t header[3];
+
+    if (!telemetry_present) {
+        return;
+    }
+
+    header[0] = TELEMETRY_MAGIC;
+    header[1] = type;
+    header[2] = (uint8_t)(head_length + tail_length);
+    uart_write(TELEMETRY_PORT, header, 3);
+    uart_write(TELEMETRY_PORT, (const uint8_t*)head, head_length);
+    uart_write(TELEMETRY_PORT, (const uint8_t*)tail, tail_length);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Console pipes                                                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Empty the pipe and stop capturing/reading.
+ */
+static void pipe_reset(void) {
+    pipe_segment_count = 0;
+    pipe_buffer_next = PIPE_BUFFER_BASE;
+    pipe_capturing = 0;
+    pipe_reading = 0;
+    pipe_read_segment = 0;
+    pipe_read_offset = 0;
+    pipe_overflowed = 0;
+}
+
+/**
+ * Append a segment, merging it with the previous one when the two runs are
+ * physically contiguous. Returns 0 if the segment table is full.
+ */
+static int pipe_add_segment(uint32_t address, uint32_t length) {
+    if (pipe_segment_count > 0) {
+        struct pipe_segment* last = &pipe_segments[pipe_segment_count - 1];
+
+        if (last->address + last->length == address) {
+            last->length += length;
+            return 1;
+        }
+    }
+
+    if (pipe_segment_count == PIPE_SEGMENT_MAX) {
+        pipe_overflowed = 1;
+        return 0;
+    }
+
+    pipe_segments[pipe_segment_count].address = address;
+    pipe_segments[pipe_segment_count].length = length;
+    pipe_segment_count++;
+    return 1;
+}
+
+/**
+ * Copy one byte of console output into the pipe buffer.
+ */
+static void pipe_write_byte(char c) {
+    if (pipe_buffer_next == PIPE_BUFFER_LIMIT) {
+        pipe_overflowed = 1;
+        return;
+    }
+
+    if (pipe_add_segment(pipe_buffer_next, 1)) {
+        *(char*)pipe_buffer_next = c;
+        pipe_buffer_next++;
+    }
+}
+
+/**
+ * Hand `length` bytes at physical `address` to the pipe without copying.
+ * The bytes must stay unchanged until the reader is done; RAM files do,
+ * since they are only ever appended. Returns 0 if the pipe is full.
+ */
+static int pipe_write_reference(uint32_t address, uint32_t length) {
+    return length == 0 || pipe_add_segment(address, length);
+}
+
+/**
+ * Return the next byte of pipe input, or -1 once every segment is consumed
+ * (or when no pipe feeds the current command).
+ */
+static int pipe_read_char(void) {
+    while (pipe_reading && pipe_read_segment < pipe_segment_count) {
+        struct pipe_segment* segment = &pipe_segments[pipe_read_segment];
+
+        if (pipe_read_offset < segment->length) {
+            return *(const uint8_t*)(segment->address + pipe_read_offset++);
+        }
+        pipe_read_segment++;
+        pipe_read_offset = 0;
+    }
+    return -1;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Screen output                                                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Frame boundary: drain the write-combining buffers so every store made to
+ * video memory so far is on screen. Nothing to do while it is uncached.
+ */
+static void vga_flush(void) {
+    if (vga_write_combining) {
+        __asm__ __volatile__("sfence" : : : "memory");
+    }
+}
+
+/**
+ * Show the shadow screen: one streaming copy into video memory per frame.
+ */
+static void console_render(void) {
+    memcpy_nt(vga_buffer, console_shadow, vga_width * vga_height * sizeof(uint16_t));
+    vga_flush();
+    console_frame_tsc = rdtsc();
+}
+
+/**
+ * Render if the visible screen is a frame behind. Called on every console
+ * write (put_char, print_sse2, newline), so it costs only an RDTSC and a
+ * compare until a frame is due. Output faster than the frame rate only
+ * scrolls the shadow; the rows in between are never drawn.
+ */
+static void console_frame_tick(void) {
+    if (rdtsc() - console_frame_tsc >= (uint64_t)time_page->tsc_khz * CONSOLE_FRAME_MS) {
+        console_render();
+    }
+}
+
+/**
+ * Scroll the screen up by one row when cursor reaches the bottom.
+ */
+static void scroll_if_needed(void) {
+    if (this_cpu(cursor_y) < vga_height) {
+        return;
+    }
+
+    int col;
+
+    /* Move each row up by one; the source and destination rows overlap. */
+    memmove(console_shadow, console_shadow + vga_width,
+            (vga_height - 1) * vga_width * sizeof(uint16_t));
+
+    /* Clear last row after shifting content upward. */
+    for (col = 0; col < vga_width; col++) {
+        console_shadow[(vga_height - 1) * vga_width + col] = (0x0F << 8) | ' ';
+    }
+
+    this_cpu(cursor_y) = vga_height - 1;
+}
+
+/**
+ * Move to a new line (column 0 of next row), then scroll if needed.
+ */
+static void newline(void) {
+    this_cpu(cursor_x) = 0;
+    this_cpu(cursor_y)++;
+    scroll_if_needed();
+    console_frame_tick();
+}
+
+/**
+ * Print one character at the current cursor position.
+ */
+static void put_char(char c) {
+    if (pipe_capturing) {
+        pipe_write_byte(c);
+        return;
+    }
+
+    if (c == '\n') {
+        serial_write_string("\r\n");
+        newline();
+        return;
+    }
+
+    serial_write_byte((uint8_t)c);
+
+    console_shadow[this_cpu(cursor_y) * vga_width + this_cpu(cursor_x)] = (0x0F << 8) | (uint8_t)c;
+    this_cpu(cursor_x)++;
+
+    if (this_cpu(cursor_x) >= vga_width) {
+        newline();
+    } else {
+        console_frame_tick();
+    }
+}
+
+/**
+ * Erase one character from the current line (used for backspace handling).
+ */
+static void backspace_char(void) {
+    if (this_cpu(cursor_x) == 0) {
+        return;
+    }
+
+    this_cpu(cursor_x)--;
+    console_shadow[this_cpu(cursor_y) * vga_width + this_cpu(cursor_x)] = (0x0F << 8) | ' ';
+    serial_write_string("\b \b");
+}
+
+/**
+ * Print a null-terminated string to the VGA text console (one put_char per
+ * byte; print_sse2 replaces it once SSE2 is patched in).
+ */
+PATCHABLE void print(const char* str) {
+    int i = 0;
+    while (str[i]) {
+        put_char(str[i]);
+        i++;
+    }
+}
+
+/**
+ * Print an unsigned 32-bit value in decimal.
+ */
+static void print_uint(uint32_t value) {
+    char digits[11];
+    int count = 0;
+
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    while (count) {
+        put_char(digits[--count]);
+    }
+}
+
+/**
+ * Clear the entire text screen and reset cursor to top-left corner.
+ */
+void clear_screen(void) {
+    int i;
+    for (i = 0; i < vga_width * vga_height; i++) {
+        console_shadow[i] = (0x0F << 8) | ' ';
+    }
+    this_cpu(cursor_x) = 0;
+    this_cpu(cursor_y) = 0;
+
+    /* ANSI: erase display, cursor home. */
+    serial_write_string("\x1b[2J\x1b[H");
+}
+
+/* -------------------------------------------------------------------------- */
+/* String helpers (self-contained replacements for libc).                     */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * Two implementations of each search/compare routine:
+ * - `_word`: four bytes per step with the "has zero byte" bit trick; the
+ *   public routine calls it until `alternatives_apply` runs, and for good
+ *   on CPUs without SSE2.
+ * - `_sse2`: sixteen bytes per step with PCMPEQB + PMOVMSKB, patched in
+ *   over the public routine's entry at boot (see ALTERNATIVE).
+ * Neither reads a block that could cross a 4KB page past the end of the
+ * data: scans use aligned loads, and compares fall back to bytes whenever a
+ * block would straddle a page boundary. Only XMM registers are touched, which
+ * `exec` programs (built without -msse) never hold live, so no
+ * kernel_fpu_begin section is needed. The SSE2 variants realign their own
+ * stack frame because vector spills at -O0 use MOVDQA.
+ */
+
+/**
+ * Compare up to `length` bytes of two strings, a word at a time.
+ */
+static int strncmp_word(const char* s1, const char* s2, uint32_t length) {
+    while (length >= 4 && !WORD_PAGE_CROSS(s1) && !WORD_PAGE_CROSS(s2)) {
+        uint32_t a = *(const uint32_t*)s1;
+
+        if (a != *(const uint32_t*)s2 || HAS_ZERO_BYTE(a)) {
+            break;
+        }
+        s1 += 4;
+        s2 += 4;
+        length -= 4;
+    }
+
+    for (; length; length--, s1++, s2++) {
+        if (*s1 != *s2 || *s1 == '\0') {
+            return (int)(uint8_t)*s1 - (int)(uint8_t)*s2;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Length of a string: bytes up to word alignment, then aligned words.
+ */
+static int strlen_word(const char* str) {
+    const char* p = str;
+
+    while ((uint32_t)p & 3) {
+        if (*p == '\0') {
+            return p - str;
+        }
+        p++;
+    }
+    while (!HAS_ZERO_BYTE(*(const uint32_t*)p)) {
+        p += 4;
+    }
+    while (*p) {
+        p++;
+    }
+    return p - str;
+}
+
+/**
+ * First occurrence of `c` in a string (or its NUL), a word at a time.
+ */
+static char* strchr_word(const char* str, int c) {
+    uint32_t pattern = (uint8_t)c * WORD_ONES;
+
+    while ((uint32_t)str & 3) {
+        if (*str == (char)c) {
+            return (char*)str;
+        }
+        if (*str == '\0') {
+            return 0;
+        }
+        str++;
+    }
+    for (;;) {
+        uint32_t w = *(const uint32_t*)str;
+
+        if (HAS_ZERO_BYTE(w) || HAS_ZERO_BYTE(w ^ pattern)) {
+            break;
+        }
+        str += 4;
+    }
+    for (;; str++) {
+        if (*str == (char)c) {
+            return (char*)str;
+        }
+        if (*str == '\0') {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Compare `length` bytes, a word at a time.
+ */
+static int memcmp_word(const void* a, const void* b, uint32_t length) {
+    const uint8_t* p = (const uint8_t*)a;
+    const uint8_t* q = (const uint8_t*)b;
+
+    while (length >= 4 && *(const uint32_t*)p == *(const uint32_t*)q) {
+        p += 4;
+        q += 4;
+        length -= 4;
+    }
+    for (; length; length--, p++, q++) {
+        if (*p != *q) {
+            return (int)*p - (int)*q;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Bitmask of the bytes in aligned block `block` equal to those in `match`.
+ */
+SSE2_FUNCTION static uint32_t sse2_match_mask(const v16qi* block, v16qi match) {
+    return (uint32_t)__builtin_ia32_pmovmskb128(__builtin_ia32_pcmpeqb128(*block, match));
+}
+
+/**
+ * SSE2 strncmp: 16-byte unaligned compares while both sides stay inside
+ * their pages, then the word routine for the remainder.
+ */
+SSE2_FUNCTION static int strncmp_sse2(const char* s1, const char* s2, uint32_t length) {
+    v16qi zero = {0};
+
+    while (length >= 16 && !SSE2_PAGE_CROSS(s1) && !SSE2_PAGE_CROSS(s2)) {
+        v16qi a = __builtin_ia32_loaddqu(s1);
+        v16qi b = __builtin_ia32_loaddqu(s2);
+        uint32_t stop = (uint32_t)__builtin_ia32_pmovmskb128(
+            __builtin_ia32_pcmpeqb128(a, b) & ~__builtin_ia32_pcmpeqb128(a, zero));
+
+        if (stop != 0xFFFF) {
+            uint32_t i = __builtin_ctz(~stop);
+            return (int)(uint8_t)s1[i] - (int)(uint8_t)s2[i];
+        }
+        s1 += 16;
+        s2 += 16;
+        length -= 16;
+    }
+    return strncmp_word(s1, s2, length);
+}
+
+/**
+ * SSE2 strlen over aligned 16-byte blocks.
+ */
+SSE2_FUNCTION static int strlen_sse2(const char* str) {
+    v16qi zero = {0};
+    uint32_t offset = (uint32_t)str & 15;
+    const v16qi* block = (const v16qi*)(str - offset);
+    uint32_t mask = sse2_match_mask(block, zero) >> offset;
+
+    if (mask) {
+        return __builtin_ctz(mask);
+    }
+    do {
+        block++;
+        mask = sse2_match_mask(block, zero);
+    } while (!mask);
+    return (const char*)block - str + __builtin_ctz(mask);
+}
+
+/**
+ * A vector with every byte set to `c`.
+ */
+SSE2_FUNCTION static v16qi sse2_splat(int c) {
+    v16qi vector;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        vector[i] = (char)c;
+    }
+    return vector;
+}
+
+/**
+ * SSE2 strchr: aligned blocks, stopping at the first `c` or NUL.
+ */
+SSE2_FUNCTION static char* strchr_sse2(const char* str, int c) {
+    const char* base = (const char*)((uint32_t)str & ~(uint32_t)15);
+    v16qi pattern = sse2_splat(c);
+    v16qi zero = {0};
+    uint32_t mask = (sse2_match_mask((const v16qi*)base, pattern) |
+                     sse2_match_mask((const v16qi*)base, zero)) &
+                    (0xFFFFu << (str - base));
+
+    while (!mask) {
+        base += 16;
+        mask = sse2_match_mask((const v16qi*)base, pattern) |
+               sse2_match_mask((const v16qi*)base, zero);
+    }
+    base += __builtin_ctz(mask);
+    return *base == (char)c ? (char*)base : 0;
+}
+
+/**
+ * SSE2 memcmp: 16-byte unaligned compares, word routine for the tail.
+ */
+SSE2_FUNCTION static int memcmp_sse2(const void* a, const void* b, uint32_t length) {
+    const uint8_t* p = (const uint8_t*)a;
+    const uint8_t* q = (const uint8_t*)b;
+
+    while (length >= 16) {
+        uint32_t equal = (uint32_t)__builtin_ia32_pmovmskb128(__builtin_ia32_pcmpeqb128(
+            __builtin_ia32_loaddqu((const char*)p), __builtin_ia32_loaddqu((const char*)q)));
+
+        if (equal != 0xFFFF) {
+            uint32_t i = __builtin_ctz(~equal);
+            return (int)p[i] - (int)q[i];
+        }
+        p += 16;
+        q += 16;
+        length -= 16;
+    }
+    return memcmp_word(p, q, length);
+}
+
+/**
+ * Compare at most `length` bytes of two strings; 0 if equal.
+ */
+PATCHABLE int strncmp(const char* s1, const char* s2, uint32_t length) {
+    return strncmp_word(s1, s2, length);
+}
+ALTERNATIVE(strncmp, strncmp_sse2, CPU_FEATURE_SSE2);
+
+/**
+ * Compare two strings; return 0 if equal.
+ */
+int strcmp(const char* s1, const char* s2) {
+    return strncmp(s1, s2, 0xFFFFFFFF);
+}
+
+/**
+ * Return the number of bytes before the terminating NUL.
+ */
+PATCHABLE int strlen(const char* str) {
+    return strlen_word(str);
+}
+ALTERNATIVE(strlen, strlen_sse2, CPU_FEATURE_SSE2);
+
+/**
+ * Return the first `c` in a string, or 0 if the string ends first.
+ */
+PATCHABLE char* strchr(const char* str, int c) {
+    return strchr_word(str, c);
+}
+ALTERNATIVE(strchr, strchr_sse2, CPU_FEATURE_SSE2);
+
+/**
+ * Compare `length` bytes; 0 if equal.
+ */
+PATCHABLE int memcmp(const void* a, const void* b, uint32_t length) {
+    return memcmp_word(a, b, length);
+}
+ALTERNATIVE(memcmp, memcmp_sse2, CPU_FEATURE_SSE2);
+
+/**
+ * Copy `length` bytes between non-overlapping buffers.
+ */
+PATCHABLE void* memcpy(void* dst, const void* src, uint32_t length) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+
+    while (length--) {
+        *d++ = *s++;
+    }
+    return dst;
+}
+
+/**
+ * memcpy as one REP MOVSB, for CPUs with fast string moves (ERMS). Uses
+ * 32-bit ESI/EDI with DS = ES = 0, like the rest of the kernel.
+ */
+static void* memcpy_erms(void* dst, const void* src, uint32_t length) {
+    void* d = dst;
+
+    __asm__ __volatile__("addr32 rep movsb" : "+D"(d), "+S"(src), "+c"(length) : : "memory");
+    return dst;
+}
+ALTERNATIVE(memcpy, memcpy_erms, CPU_FEATURE_ERMS);
+
+/**
+ * Copy `length` bytes between buffers that may overlap. With `dst` below
+ * `src` each word is read before anything at or past it is written, so the
+ * copy runs forward a word at a time; otherwise it runs backward by bytes.
+ */
+void* memmove(void* dst, const void* src, uint32_t length) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+
+    if (d <= s) {
+        for (; length >= 4; length -= 4, d += 4, s += 4) {
+            *(uint32_t*)d = *(const uint32_t*)s;
+        }
+        while (length--) {
+            *d++ = *s++;
+        }
+        return dst;
+    }
+
+    d += length;
+    s += length;
+    while (length--) {
+        *--d = *--s;
+    }
+    return dst;
+}
+
+/**
+ * memcpy_nt with SSE2: from MEMCPY_NT_THRESHOLD bytes up, align the
+ * destination and copy 16-byte blocks with MOVNTDQ, which writes around
+ * the cache, then SFENCE so the weakly ordered stores land before return.
+ */
+SSE2_FUNCTION static void* memcpy_nt_sse2(void* dst, const void* src, uint32_t length) {
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    uint32_t head;
+
+    if (length < MEMCPY_NT_THRESHOLD) {
+        return memcpy(dst, src, length);
+    }
+
+    head = -(uint32_t)d & 15;
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    length -= head;
+
+    for (; length >= 16; length -= 16, d += 16, s += 16) {
+        __builtin_ia32_movntdq((v2di*)d, (v2di)__builtin_ia32_loaddqu((const char*)s));
+    }
+    __builtin_ia32_sfence();
+
+    memcpy(d, s, length);
+    return dst;
+}
+
+/**
+ * Copy a large buffer that will not be read back soon (screen frames)
+ * between non-overlapping buffers, without evicting the working set. Only
+ * the stores stream: `src` is read with ordinary loads, so it should be
+ * cached RAM, not video memory. Plain memcpy until SSE2 is patched in.
+ */
+PATCHABLE void* memcpy_nt(void* dst, const void* src, uint32_t length) {
+    return memcpy(dst, src, length);
+}
+ALTERNATIVE(memcpy_nt, memcpy_nt_sse2, CPU_FEATURE_SSE2);
+
+/**
+ * Fill `length` bytes with `value`.
+ */
+void* memset(void* dst, int value, uint32_t length) {
+    uint8_t* d = (uint8_t*)dst;
+
+    while (length--) {
+        *d++ = (uint8_t)value;
+    }
+    return dst;
+}
+
+/**
+ * Return nonzero if `str` begins with `prefix`.
+ */
+static int str_starts_with(const char* str, const char* prefix) {
+    return strncmp(str, prefix, strlen(prefix)) == 0;
+}
+
+/**
+ * Copy at most `size - 1` bytes of `src` into `dst` and NUL-terminate it.
+ */
+static void str_copy(char* dst, const char* src, int size) {
+    while (size > 1 && *src) {
+        *dst++ = *src++;
+        size--;
+    }
+    *dst = '\0';
+}
+
+/**
+ * Return nonzero if `needle` occurs anywhere in `haystack`.
+ */
+static int str_contains(const char* haystack, const char* needle) {
+    int length = strlen(needle);
+
+    if (length == 0) {
+        return 1;
+    }
+    /* Jump between occurrences of the first byte instead of every offset. */
+    while ((haystack = strchr(haystack, needle[0])) != 0) {
+        if (strncmp(haystack, needle, length) == 0) {
+            return 1;
+        }
+        haystack++;
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Vectorized console output                                                  */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * print with SSE2: while 16 bytes of text fit on the current row, test them
+ * for control characters (and the NUL) at once (c <= 0x1F iff
+ * PMINUB(c, 0x1F) == c) and, if there are none, expand them into 16 cells
+ * with PUNPCKLBW/PUNPCKHBW against the attribute byte. Everything else --
+ * pipes, row ends, control bytes, blocks that would cross into the next
+ * page -- goes through put_char.
+ */
+SSE2_FUNCTION static void print_sse2(const char* str) {
+    v16qi control = sse2_splat(0x1F);
+    v16qi attribute = sse2_splat(0x0F);
+
+    while (*str) {
+        uint16_t* cells = console_shadow + this_cpu(cursor_y) * vga_width + this_cpu(cursor_x);
+        v16qi text;
+        int i;
+
+        if (pipe_capturing || this_cpu(cursor_x) > vga_width - 16 || SSE2_PAGE_CROSS(str)) {
+            put_char(*str++);
+            continue;
+        }
+
+        text = __builtin_ia32_loaddqu(str);
+        if (__builtin_ia32_pmovmskb128(
+                __builtin_ia32_pcmpeqb128(__builtin_ia32_pminub128(text, control), text))) {
+            put_char(*str++);
+            continue;
+        }
+
+        __builtin_ia32_storedqu((char*)cells, __builtin_ia32_punpcklbw128(text, attribute));
+        __builtin_ia32_storedqu((char*)(cells + 8), __builtin_ia32_punpckhbw128(text, attribute));
+        for (i = 0; i < 16; i++) {
+            serial_write_byte((uint8_t)str[i]);
+        }
+        str += 16;
+        this_cpu(cursor_x) += 16;
+        if (this_cpu(cursor_x) >= vga_width) {
+            newline();
+        } else {
+            console_frame_tick();
+        }
+    }
+}
+ALTERNATIVE(print, print_sse2, CPU_FEATURE_SSE2);
+
+/* -------------------------------------------------------------------------- */
+/* RAM files                                                                  */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Reserve `size` bytes in the RAMFS window and add a table entry for them.
+ * Returns the new entry, or 0 if the table or the window is full. The caller
+ * fills the data at `file->address`.
+ */
+static struct ram_file* ram_file_create(const char* name, uint32_t size) {
+    if (ram_file_count == RAM_FILE_MAX || size > RAMFS_LIMIT - ramfs_next) {
+        return 0;
+    }
+
+    struct ram_file* file = &ram_files[ram_file_count++];
+    str_copy(file->name, name, RAM_FILE_NAME_SIZE);
+    file->address = ramfs_next;
+    file->size = size;
+
+    /* Keep every file 16-byte aligned for block copies. */
+    ramfs_next = (ramfs_next + size + 15) & ~(uint32_t)15;
+    return file;
+}
+
+/**
+ * Drop the most recently created RAM file and give its space back.
+ * Used to undo a `ram_file_create` whose fill step failed.
+ */
+static void ram_file_remove_last(void) {
+    ram_file_count--;
+    ramfs_next = ram_files[ram_file_count].address;
+}
+
+/**
+ * Look up a RAM file by exact name; returns 0 if absent.
+ */
+static struct ram_file* ram_file_find(const char* name) {
+    int i;
+
+    for (i = 0; i < ram_file_count; i++) {
+        if (strcmp(ram_files[i].name, name) == 0) {
+            return &ram_files[i];
+        }
+    }
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/* QEMU fw_cfg (DMA interface)                                                */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Run one fw_cfg DMA read: optionally select `item` first, then copy
+ * `length` bytes into physical `address`. Returns 0 on success.
+ *
+ * The descriptor address is written high word first; the low-word write
+ * starts the transfer. QEMU completes it synchronously, but the control word
+ * is still polled as the spec requires.
+ */
+static int fwcfg_dma_read(int select, uint16_t item, uint32_t address, uint32_t length) {
+    static volatile struct fwcfg_dma_access access;
+    uint32_t control = FWCFG_DMA_READ;
+
+    if (select) {
+        control |= FWCFG_DMA_SELECT | ((uint32_t)item << 16);
+    }
+
+    access.control = bswap32(control);
+    access.length = bswap32(length);
+    access.address_high = 0;
+    access.address_low = bswap32(address);
+
+    outl(FWCFG_DMA_HIGH_PORT, 0);
+    outl(FWCFG_DMA_LOW_PORT, bswap32((uint32_t)(unsigned int)&access));
+
+    while (bswap32(access.control) & ~(uint32_t)FWCFG_DMA_ERROR) {
+    }
+
+    return (bswap32(access.control) & FWCFG_DMA_ERROR) ? -1 : 0;
+}
+
+/**
+ * Detect fw_cfg through the "QEMU" signature and the DMA feature bit. The
+ * probe uses the legacy byte-wide data port, which needs no DMA support.
+ */
+static void fwcfg_init(void) {
+    const char* signature = "QEMU";
+    uint8_t features;
+    int i;
+
+    outw(FWCFG_SELECTOR_PORT, FWCFG_SIGNATURE);
+    for (i = 0; i < 4; i++) {
+        if (inb(FWCFG_DATA_PORT) != (uint8_t)signature[i]) {
+            return;
+        }
+    }
+
+    outw(FWCFG_SELECTOR_PORT, FWCFG_ID);
+    features = inb(FWCFG_DATA_PORT);
+    fwcfg_dma_present = (features & FWCFG_FEATURE_DMA) != 0;
+}
+
+/**
+ * Snapshot the fw_cfg file directory (item 0x19) into `fwcfg_directory`.
+ *
+ * The count and the first FWCFG_DIR_CACHE_MAX entries arrive in two DMA
+ * transfers; size/select are converted to host byte order once, here.
+ */
+static void fwcfg_read_directory(void) {
+    static uint32_t count;
+    int i;
+
+    if (!fwcfg_dma_present) {
+        return;
+    }
+    if (fwcfg_dma_read(1, FWCFG_FILE_DIR, (uint32_t)(unsigned int)&count, 4) != 0) {
+        return;
+    }
+
+    fwcfg_directory_total = bswap32(count);
+    fwcfg_directory_count = fwcfg_directory_total < FWCFG_DIR_CACHE_MAX
+                                ? (int)fwcfg_directory_total
+                                : FWCFG_DIR_CACHE_MAX;
+
+    if (fwcfg_dma_read(0, 0, (uint32_t)(unsigned int)fwcfg_directory,
+                       fwcfg_directory_count * sizeof(struct fwcfg_file)) != 0) {
+        fwcfg_directory_count = 0;
+        return;
+    }
+
+    for (i = 0; i < fwcfg_directory_count; i++) {
+        struct fwcfg_file* entry = &fwcfg_directory[i];
+        entry->size = bswap32(entry->size);
+        entry->select = (uint16_t)((entry->select >> 8) | (entry->select << 8));
+    }
+}
+
+/**
+ * Copy every cached `opt/...` fw_cfg file into a RAM file, one DMA transfer
+ * each.
+ */
+static void fwcfg_load_files(void) {
+    int i;
+
+    fwcfg_read_directory();
+
+    for (i = 0; i < fwcfg_directory_count; i++) {
+        struct fwcfg_file* entry = &fwcfg_directory[i];
+
+        if (!str_starts_with(entry->name, "opt/")) {
+            continue;
+        }
+
+        struct ram_file* file = ram_file_create(entry->name, entry->size);
+        if (!file) {
+            print("fw_cfg: no room for ");
+            print(entry->name);
+            print("\n");
+            continue;
+        }
+        if (fwcfg_dma_read(1, entry->select, file->address, file->size) != 0) {
+            print("fw_cfg: DMA error on ");
+            print(entry->name);
+            print("\n");
+            ram_file_remove_last();
+            continue;
+        }
+    }
+
+    if (ram_file_count) {
+        print("fw_cfg: loaded ");
+        print_uint((uint32_t)ram_file_count);
+        print(" file(s) into RAM\n");
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Keyboard input                                                             */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Translate a Set-1 keyboard scancode (press event) into an unshifted ASCII
+ * character. Returns 0 for unsupported keys.
+ *
+ * This mapping intentionally includes only commonly used characters for this
+ * educational shell to keep the code focused and readable.
+ */
+static char scancode_to_ascii(uint8_t scancode) {
+    switch (scancode) {
+        case 0x02: return '1'; case 0x03: return '2'; case 0x04: return '3';
+        case 0x05: return '4'; case 0x06: return '5'; case 0x07: return '6';
+        case 0x08: return '7'; case 0x09: return '8'; case 0x0A: return '9';
+        case 0x0B: return '0';
+
+        case 0x10: return 'q'; case 0x11: return 'w'; case 0x12: return 'e';
+        case 0x13: return 'r'; case 0x14: return 't'; case 0x15: return 'y';
+        case 0x16: return 'u'; case 0x17: return 'i'; case 0x18: return 'o';
+        case 0x19: return 'p'; case 0x1E: return 'a'; case 0x1F: return 's';
+        case 0x20: return 'd'; case 0x21: return 'f'; case 0x22: return 'g';
+        case 0x23: return 'h'; case 0x24: return 'j'; case 0x25: return 'k';
+        case 0x26: return 'l'; case 0x2C: return 'z'; case 0x2D: return 'x';
+        case 0x2E: return 'c'; case 0x2F: return 'v'; case 0x30: return 'b';
+        case 0x31: return 'n'; case 0x32: return 'm';
+
+        case 0x34: return '.'; case 0x35: return '/';
+        case 0x2B: return '\\';
+
+        case 0x39: return ' ';  /* Space bar */
+        case 0x0C: return '-';
+        case 0x0D: return '=';
+        default: return 0;
+    }
+}
+
+/**
+ * US-layout Shift form of a character from scancode_to_ascii: uppercase for
+ * letters, the symbol on the key otherwise (Shift + backslash gives the
+ * shell's '|').
+ */
+static char keyboard_shifted(char c) {
+    static const char digits[] = ")!@#$%^&*(";
+
+    if (c >= 'a' && c <= 'z') {
+        return (char)(c - 'a' + 'A');
+    }
+    if (c >= '0' && c <= '9') {
+        return digits[c - '0'];
+    }
+    switch (c) {
+        case '-': return '_'; case '=': return '+';
+        case '.': return '>'; case '/': return '?';
+        case '\\': return '|';
+        default: return c;
+    }
+}
+
+/**
+ * Route IRQ1 to `keyboard_irq_stub` and start with IRQ1 masked.
+ */
+static void keyboard_init(void) {
+    __asm__ __volatile__("cli");
+    ivt_set_vector(KEYBOARD_IRQ_VECTOR, keyboard_irq_stub);
+    outb(PIC1_DATA_PORT, inb(PIC1_DATA_PORT) | PIC_IRQ1_KEYBOARD);
+    __asm__ __volatile__("sti");
+}
+
+/**
+ * Drain up to KEYBOARD_POLL_BUDGET bytes from the controller into the ring.
+ * Returns the number of bytes consumed from the controller.
+ *
+ * Notes:
+ * - Status port bit 0 indicates output buffer full (data ready).
+ * - Key release scancodes (high bit set) are consumed but not queued,
+ *   except for the Shift keys, whose state the consumer tracks.
+ * - A full ring stops the drain; the byte waits in the controller instead
+ *   of being dropped.
+ */
+static int keyboard_poll(void) {
+    int work = 0;
+
+    while (work < KEYBOARD_POLL_BUDGET) {
+        if ((uint8_t)(keyboard_ring_head - keyboard_ring_tail) == KEYBOARD_RING_SIZE) {
+            break;
+        }
+        if ((inb(KEYBOARD_STATUS_PORT) & 0x01) == 0) {
+            break;
+        }
+
+        uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+        work++;
+
+        if ((scancode & KEYBOARD_RELEASE) &&
+            scancode != (KEYBOARD_LEFT_SHIFT | KEYBOARD_RELEASE) &&
+            scancode != (KEYBOARD_RIGHT_SHIFT | KEYBOARD_RELEASE)) {
+            continue;
+        }
+
+        keyboard_ring[keyboard_ring_head & (KEYBOARD_RING_SIZE - 1)] = scancode;
+        keyboard_ring_head++;
+    }
+
+    return work;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Console input (keyboard + COM1)                                            */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Sleep until the next keyboard or serial interrupt (or any other IRQ, e.g.
+ * the timer).
+ *
+ * IRQ1/IRQ4 are unmasked only here, with both devices already empty. Checking
+ * the status ports with interrupts disabled and then executing `sti; hlt` as
+ * a pair closes the window where input could arrive between check and sleep.
+ */
+static void console_wait_for_irq(void) {
+    /* Going idle: this is where staged console output reaches the host. */
+    serial_flush();
+    console_render();
+
+    __asm__ __volatile__("cli");
+
+    if ((inb(KEYBOARD_STATUS_PORT) & 0x01) || serial_received()) {
+        __asm__ __volatile__("sti");
+        return;
+    }
+
+    uint8_t unmask = PIC_IRQ1_KEYBOARD;
+    if (serial_present) {
+        unmask |= PIC_IRQ4_SERIAL;
+    }
+
+    outb(PIC1_DATA_PORT, inb(PIC1_DATA_PORT) & (uint8_t)~unmask);
+    __asm__ __volatile__("sti\n\thlt");
+}
+
+/**
+ * Translate one queued keyboard scancode into a console character:
+ * '\n' for Enter, '\b' for Backspace, ASCII for mapped keys (shifted while
+ * Shift is held), 0 otherwise. Shift presses and releases update
+ * `keyboard_shift` and produce 0.
+ */
+static char keyboard_read_char(void) {
+    uint8_t scancode = keyboard_ring[keyboard_ring_tail++ & (KEYBOARD_RING_SIZE - 1)];
+    char c;
+
+    if ((scancode & ~KEYBOARD_RELEASE) == KEYBOARD_LEFT_SHIFT ||
+        (scancode & ~KEYBOARD_RELEASE) == KEYBOARD_RIGHT_SHIFT) {
+        keyboard_shift = !(scancode & KEYBOARD_RELEASE);
+        return 0;
+    }
+    if (scancode == 0x1C) {
+        return '\n';
+    }
+    if (scancode == 0x0E) {
+        return '\b';
+    }
+    c = scancode_to_ascii(scancode);
+    return keyboard_shift ? keyboard_shifted(c) : c;
+}
+
+/**
+ * Translate one received serial byte into a console character.
+ *
+ * Terminals send Enter as CR, LF, CR LF or CR NUL; the byte after a CR is
+ * swallowed so each of these yields exactly one '\n'. DEL and BS both map
+ * to '\b'. Other control bytes are ignored (returns 0).
+ */
+static char serial_read_char(void) {
+    uint8_t byte = inb(SERIAL_PORT + SERIAL_DATA);
+    uint8_t previous = serial_last_byte;
+
+    serial_last_byte = byte;
+
+    if (previous == '\r' && (byte == '\n' || byte == 0)) {
+        return 0;
+    }
+    if (byte == '\r' || byte == '\n') {
+        return '\n';
+    }
+    if (byte == 0x7F || byte == 0x08) {
+        return '\b';
+    }
+    if (byte < 0x20 || byte > 0x7E) {
+        return 0;
+    }
+    return (char)byte;
+}
+
+/**
+ * Block until either input device produces a console character.
+ */
+static char console_read_char(void) {
+    while (1) {
+        if (keyboard_ring_head != keyboard_ring_tail) {
+            char c = keyboard_read_char();
+            if (c) {
+                return c;
+            }
+            continue;
+        }
+
+        if (serial_received()) {
+            char c = serial_read_char();
+            if (c) {
+                return c;
+            }
+            continue;
+        }
+
+        /* The NE2000 has no IRQ wired: poll it on every wake-up instead. */
+        net_poll();
+        if (keyboard_poll() == 0) {
+            console_wait_for_irq();
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Serial file upload (recv)                                                  */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * One host -> guest upload frame after the sync byte.
+ */
+struct recv_frame {
+    uint8_t type;
+    uint8_t seq;
+    uint8_t length;
+    uint8_t payload[RECV_PAYLOAD_MAX];
+};
+
+/**
+ * Read the BIOS timer tick counter.
+ */
+static uint32_t bios_ticks(void) {
+    return *(volatile uint32_t*)BIOS_TICK_COUNT;
+}
+
+/**
+ * Read one raw COM1 byte, or return -1 after RECV_TIMEOUT_TICKS of silence.
+ */
+static int serial_read_byte_timeout(void) {
+    uint32_t started = bios_ticks();
+
+    while (!serial_received()) {
+        if (bios_ticks() - started > RECV_TIMEOUT_TICKS) {
+            return -1;
+        }
+    }
+    return inb(SERIAL_PORT + SERIAL_DATA);
+}
+
+/**
+ * CRC-16/CCITT-FALSE (poly 0x1021), bitwise. Even unrolled per bit it costs
+ * far less than the ~87 us a byte takes to arrive at 115200 baud.
+ */
+static uint16_t crc16_ccitt(uint16_t crc, const uint8_t* data, int length) {
+    while (length--) {
+        int bit;
+
+        crc ^= (uint16_t)(*data++ << 8);
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * Send a 3-byte reply frame. The sequence number is cut to 7 bits so the
+ * reply never contains 0xFF, which a telnet transport would treat as IAC.
+ */
+static void recv_reply(uint8_t type, uint8_t seq) {
+    uint8_t reply[3];
+
+    reply[0] = RECV_SYNC;
+    reply[1] = type;
+    reply[2] = seq & 0x7F;
+    uart_write(SERIAL_PORT, reply, 3);
+}
+
+/**
+ * Receive one frame. Returns 1 for a valid frame, 0 for a corrupt one
+ * (oversized length or CRC mismatch), -1 on timeout.
+ */
+static int recv_read_frame(struct recv_frame* frame) {
+    uint8_t* header = &frame->type;
+    int byte;
+    int i;
+
+    do {
+        byte = serial_read_byte_timeout();
+        if (byte < 0) {
+            return -1;
+        }
+    } while (byte != RECV_SYNC);
+
+    for (i = 0; i < 3; i++) {
+        if ((byte = serial_read_byte_timeout()) < 0) {
+            return -1;
+        }
+        header[i] = (uint8_t)byte;
+    }
+    if (frame->length > RECV_PAYLOAD_MAX) {
+        return 0;
+    }
+
+    for (i = 0; i < frame->length; i++) {
+        if ((byte = serial_read_byte_timeout()) < 0) {
+            return -1;
+        }
+        frame->payload[i] = (uint8_t)byte;
+    }
+
+    uint16_t crc = 0;
+    for (i = 0; i < 2; i++) {
+        if ((byte = serial_read_byte_timeout()) < 0) {
+            return -1;
+        }
+        crc = (uint16_t)((crc << 8) | (uint8_t)byte);
+    }
+
+    return crc16_ccitt(0xFFFF, header, 3 + frame->length) == crc;
+}
+
+/**
+ * `recv <name>`: receive a file from tools/sendfile.py into a new RAM file.
+ *
+ * Go-back-N receiver: only the next expected frame is accepted and each one
+ * is acknowledged immediately, so the sender can keep a full window of
+ * frames in flight and the line never idles waiting for a per-byte or
+ * per-frame handshake. A corrupt or out-of-order frame triggers one NAK for
+ * the expected sequence number; later strays are dropped silently until the
+ * resend arrives (if the resend is lost too, the sender's timeout recovers).
+ */
+static void command_recv(const char* name) {
+    struct recv_frame frame;
+    struct ram_file* file = 0;
+    uint32_t received = 0;
+    uint8_t expected = 0;
+    int nak_sent = 0;
+    uint32_t started;
+
+    if (!serial_present) {
+        print("recv: no serial port\n");
+        return;
+    }
+    if (*name == '\0') {
+        print("Usage: recv <name>\n");
+        return;
+    }
+    if (ram_file_find(name)) {
+        print("recv: file exists: ");
+        print(name);
+        print("\n");
+        return;
+    }
+
+    print("recv: waiting for sender (tools/sendfile.py)...\n");
+    serial_flush();
+    console_render();
+    recv_reply(RECV_REPLY_READY, 0);
+    started = bios_ticks();
+
+    while (1) {
+        int status = recv_read_frame(&frame);
+
+        if (status < 0) {
+            print("recv: timed out\n");
+            break;
+        }
+        if (status == 0 || frame.seq != expected) {
+            if (!nak_sent) {
+                recv_reply(RECV_REPLY_NAK, expected);
+                nak_sent = 1;
+            }
+            continue;
+        }
+        nak_sent = 0;
+
+        if (frame.type == RECV_FRAME_START && !file && frame.length == 4) {
+            uint32_t size = frame.payload[0] | ((uint32_t)frame.payload[1] << 8) |
+                            ((uint32_t)frame.payload[2] << 16) | ((uint32_t)frame.payload[3] << 24);
+
+            file = ram_file_create(name, size);
+            if (!file) {
+                recv_reply(RECV_REPLY_FAIL, expected);
+                print("recv: no room for file\n");
+                return;
+            }
+        } else if (frame.type == RECV_FRAME_DATA && file &&
+                   frame.length <= file->size - received) {
+            memcpy((void*)(file->address + received), frame.payload, frame.length);
+            received += frame.length;
+        } else if (frame.type == RECV_FRAME_END && file && received == file->size) {
+            uint32_t ticks = bios_ticks() - started;
+
+            recv_reply(RECV_REPLY_ACK, expected);
+            print("recv: ");
+            print_uint(received);
+            print(" bytes in ");
+            print_uint(ticks);
+            print(" ticks");
+            if (ticks) {
+                print(" (");
+                print_uint(received * BIOS_TICKS_PER_10S / (ticks * 10));
+                print(" bytes/s)");
+            }
+            print("\n");
+            return;
+        } else {
+            recv_reply(RECV_REPLY_FAIL, expected);
+            print("recv: protocol error\n");
+            break;
+        }
+
+        recv_reply(RECV_REPLY_ACK, expected);
+        expected++;
+    }
+
+    if (file) {
+        ram_file_remove_last();
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* NE2000 network card (QEMU ne2k_isa)                                        */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Start a remote DMA transfer of `length` bytes at card address `address`;
+ * the bytes then move one at a time through NE2K_DATA.
+ */
+static void ne2k_dma_start(uint16_t address, uint16_t length, uint8_t direction) {
+    outb(NE2K_BASE + NE2K_DMA_COUNT, (uint8_t)length);
+    outb(NE2K_BASE + NE2K_DMA_COUNT + 1, (uint8_t)(length >> 8));
+    outb(NE2K_BASE + NE2K_DMA_ADDRESS, (uint8_t)address);
+    outb(NE2K_BASE + NE2K_DMA_ADDRESS + 1, (uint8_t)(address >> 8));
+    outb(NE2K_BASE + NE2K_COMMAND, direction | NE2K_CR_START);
+}
+
+/**
+ * Copy `length` bytes of card memory at `address` into `buffer`. Reads
+ * past the end of the receive ring wrap to its start in the card.
+ */
+static void ne2k_read(uint16_t address, uint8_t* buffer, uint16_t length) {
+    ne2k_dma_start(address, length, NE2K_CR_DMA_READ);
+    while (length--) {
+        *buffer++ = inb(NE2K_BASE + NE2K_DATA);
+    }
+    outb(NE2K_BASE + NE2K_ISR, NE2K_ISR_DMA_DONE);
+}
+
+/**
+ * Reset the card, read its MAC address from the station PROM (each byte
+ * appears twice in byte-wide mode), and start it with the receive ring in
+ * place and broadcasts accepted. No card answers when CR does not read
+ * back what was written: an empty ISA port reads 0xFF.
+ */
+static void ne2k_init(void) {
+    uint8_t prom[12];
+    int i;
+
+    outb(NE2K_BASE + NE2K_RESET, inb(NE2K_BASE + NE2K_RESET));
+    outb(NE2K_BASE + NE2K_COMMAND, NE2K_CR_NO_DMA | NE2K_CR_STOP);
+    if (inb(NE2K_BASE + NE2K_COMMAND) != (NE2K_CR_NO_DMA | NE2K_CR_STOP)) {
+        return;
+    }
+
+    outb(NE2K_BASE + NE2K_DATA_CONFIG, NE2K_DCR_BYTE_NORMAL);
+    outb(NE2K_BASE + NE2K_IMR, 0);
+    outb(NE2K_BASE + NE2K_ISR, 0xFF);
+    outb(NE2K_BASE + NE2K_RX_CONFIG, 0);
+    outb(NE2K_BASE + NE2K_TX_CONFIG, 0);
+    outb(NE2K_BASE + NE2K_PAGE_START, NE2K_RX_START);
+    outb(NE2K_BASE + NE2K_PAGE_STOP, NE2K_RX_STOP);
+    outb(NE2K_BASE + NE2K_BOUNDARY, NE2K_RX_START);
+
+    ne2k_read(0, prom, sizeof(prom));
+    outb(NE2K_BASE + NE2K_COMMAND, NE2K_CR_PAGE1 | NE2K_CR_NO_DMA | NE2K_CR_STOP);
+    for (i = 0; i < 6; i++) {
+        ne2k_mac[i] = prom[i * 2];
+        outb(NE2K_BASE + NE2K_STATION + i, ne2k_mac[i]);
+    }
+    outb(NE2K_BASE + NE2K_CURRENT, NE2K_RX_START + 1);
+
+    outb(NE2K_BASE + NE2K_COMMAND, NE2K_CR_NO_DMA | NE2K_CR_START);
+    outb(NE2K_BASE + NE2K_RX_CONFIG, NE2K_RCR_BROADCAST);
+    ne2k_present = 1;
+}
+
+/**
+ * Transmit one Ethernet frame of at least ETH_FRAME_MIN bytes (the caller
+ * pads) and wait until the card reports it sent or failed.
+ */
+static void ne2k_send(const uint8_t* frame, uint16_t length) {
+    uint16_t i;
+
+    ne2k_dma_start(NE2K_TX_START << 8, length, NE2K_CR_DMA_WRITE);
+    for (i = 0; i < length; i++) {
+        outb(NE2K_BASE + NE2K_DATA, frame[i]);
+    }
+    outb(NE2K_BASE + NE2K_ISR, NE2K_ISR_DMA_DONE);
+
+    outb(NE2K_BASE + NE2K_TX_PAGE, NE2K_TX_START);
+    outb(NE2K_BASE + NE2K_TX_COUNT, (uint8_t)length);
+    outb(NE2K_BASE + NE2K_TX_COUNT + 1, (uint8_t)(length >> 8));
+    outb(NE2K_BASE + NE2K_COMMAND, NE2K_CR_NO_DMA | NE2K_CR_TRANSMIT | NE2K_CR_START);
+    while (!(inb(NE2K_BASE + NE2K_ISR) & (NE2K_ISR_TX | NE2K_ISR_TX_ERROR))) {
+    }
+    outb(NE2K_BASE + NE2K_ISR, NE2K_ISR_TX | NE2K_ISR_TX_ERROR);
+}
+
+/**
+ * Move the oldest frame off the receive ring into `buffer`, truncated to
+ * `size` bytes. Returns its length, or 0 when the ring is empty.
+ *
+ * The ring is empty when the page after BOUNDARY is CURRENT. Each frame
+ * starts with a 4-byte header {status, next page, length low, length high}
+ * whose length counts the header too; BOUNDARY then trails the next page.
+ */
+static uint16_t ne2k_receive(uint8_t* buffer, uint16_t size) {
+    uint8_t header[4];
+    uint8_t page = inb(NE2K_BASE + NE2K_BOUNDARY) + 1;
+    uint8_t current;
+    uint16_t length;
+
+    if (page == NE2K_RX_STOP) {
+        page = NE2K_RX_START;
+    }
+    outb(NE2K_BASE + NE2K_COMMAND, NE2K_CR_PAGE1 | NE2K_CR_NO_DMA | NE2K_CR_START);
+    current = inb(NE2K_BASE + NE2K_CURRENT);
+    outb(NE2K_BASE + NE2K_COMMAND, NE2K_CR_NO_DMA | NE2K_CR_START);
+    if (page == current) {
+        return 0;
+    }
+
+    ne2k_read(page << 8, header, sizeof(header));
+    length = (uint16_t)(header[2] | header[3] << 8) - sizeof(header);
+    if (length > size) {
+        length = size;
+    }
+    ne2k_read((page << 8) + sizeof(header), buffer, length);
+    outb(NE2K_BASE + NE2K_BOUNDARY, header[1] == NE2K_RX_START ? NE2K_RX_STOP - 1 : header[1] - 1);
+    return length;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Network stack (Ethernet, ARP, IPv4, ICMP, UDP)                             */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Swap the bytes of a 16-bit value (host <-> network order).
+ */
+static uint16_t net_swap16(uint16_t value) {
+    return (uint16_t)(value << 8 | value >> 8);
+}
+
+/**
+ * Internet checksum (RFC 1071) of `length` bytes, ready to store as is.
+ * Adds a 32-bit word (two 16-bit fields) per step into a 64-bit sum and
+ * folds the carries once at the end; the ones' complement sum comes out
+ * the same for any word width and either byte order.
+ */
+static uint16_t net_checksum(const void* data, uint32_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t sum = 0;
+
+    for (; length >= 4; length -= 4, p += 4) {
+        sum += *(const uint32_t*)p;
+    }
+    if (length >= 2) {
+        sum += *(const uint16_t*)p;
+        p += 2;
+        length -= 2;
+    }
+    if (length) {
+        sum += *p;
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+/**
+ * Take a free pool buffer with one reference and room for headers in
+ * front of `data`. Returns 0 when every buffer is held.
+ */
+static struct net_buffer* net_buffer_alloc(void) {
+    int i;
+
+    for (i = 0; i < NET_BUFFER_COUNT; i++) {
+        struct net_buffer* buffer = &net_buffers[i];
+
+        if (buffer->refs == 0) {
+            buffer->refs = 1;
+            buffer->data = (uint8_t*)NET_POOL_BASE + i * NET_BUFFER_SIZE + NET_BUFFER_HEADROOM;
+            buffer->length = 0;
+            return buffer;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Drop one reference; the last one returns the buffer to the pool.
+ */
+static void net_buffer_put(struct net_buffer* buffer) {
+    buffer->refs--;
+}
+
+/**
+ * Prepend `size` bytes into the headroom and return the new start.
+ */
+static void* net_buffer_push(struct net_buffer* buffer, uint16_t size) {
+    buffer->data -= size;
+    buffer->length += size;
+    return buffer->data;
+}
+
+/**
+ * Strip a `size`-byte header off the front.
+ */
+static void net_buffer_pull(struct net_buffer* buffer, uint16_t size) {
+    buffer->data += size;
+    buffer->length -= size;
+}
+
+/**
+ * Prepend the Ethernet header, pad to the 60-byte minimum, transmit, and
+ * drop the caller's reference (every send function consumes one).
+ */
+static void net_eth_send(struct net_buffer* buffer, const uint8_t* destination, uint16_t type) {
+    struct eth_header* eth = net_buffer_push(buffer, sizeof(*eth));
+
+    memcpy(eth->destination, destination, 6);
+    memcpy(eth->source, ne2k_mac, 6);
+    eth->type = net_swap16(type);
+    if (buffer->length < ETH_FRAME_MIN) {
+        memset(buffer->data + buffer->length, 0, ETH_FRAME_MIN - buffer->length);
+        buffer->length = ETH_FRAME_MIN;
+    }
+    ne2k_send(buffer->data, buffer->length);
+    net_buffer_put(buffer);
+}
+
+/**
+ * ARP cache slot for `ip`: its four bytes XOR-folded, masked to the table.
+ * Each address has one possible slot; a new address evicts the old one.
+ */
+static struct neighbour* net_neighbour_slot(uint32_t ip) {
+    ip ^= ip >> 16;
+    ip ^= ip >> 8;
+    return &net_neighbours[ip & (NET_NEIGHBOUR_COUNT - 1)];
+}
+
+/**
+ * Send an ARP packet as 10.0.2.15: a broadcast request for `ip`
+ * (`mac` = net_unknown_mac) or a reply to `mac`/`ip`.
+ */
+static void net_arp_send(uint16_t operation, const uint8_t* mac, uint32_t ip) {
+    struct net_buffer* buffer = net_buffer_alloc();
+    struct arp_packet* arp;
+
+    if (!buffer) {
+        return;
+    }
+    arp = net_buffer_push(buffer, sizeof(*arp));
+    arp->hardware_type = net_swap16(ARP_HARDWARE_ETHERNET);
+    arp->protocol_type = net_swap16(ETH_TYPE_IPV4);
+    arp->hardware_size = 6;
+    arp->protocol_size = 4;
+    arp->operation = net_swap16(operation);
+    memcpy(arp->sender_mac, ne2k_mac, 6);
+    arp->sender_ip = NET_GUEST_IP;
+    memcpy(arp->target_mac, mac, 6);
+    arp->target_ip = ip;
+    net_eth_send(buffer, operation == ARP_REQUEST ? net_broadcast_mac : mac, ETH_TYPE_ARP);
+}
+
+/**
+ * Record `ip` at `mac` and send the packet that was waiting for it.
+ */
+static void net_neighbour_update(uint32_t ip, const uint8_t* mac) {
+    struct neighbour* entry = net_neighbour_slot(ip);
+    struct net_buffer* pending = entry->pending;
+
+    entry->pending = 0;
+    if (pending && entry->ip != ip) {
+        net_buffer_put(pending);
+        pending = 0;
+    }
+    entry->ip = ip;
+    memcpy(entry->mac, mac, 6);
+    entry->resolved = 1;
+    if (pending) {
+        net_eth_send(pending, mac, ETH_TYPE_IPV4);
+    }
+}
+
+/**
+ * Prepend an IPv4 header and send to `destination`: directly on the
+ * 10.0.2.0/24 subnet, through the gateway otherwise. An unresolved next
+ * hop is sent an ARP request and keeps the packet as its pending one
+ * (replacing any older one). Consumes the caller's reference.
+ */
+static void net_ipv4_send(struct net_buffer* buffer, uint32_t destination, uint8_t protocol) {
+    struct ipv4_header* ip = net_buffer_push(buffer, sizeof(*ip));
+    uint32_t hop = ((destination ^ NET_GUEST_IP) & NET_SUBNET_MASK) ? NET_GATEWAY_IP : destination;
+    struct neighbour* entry = net_neighbour_slot(hop);
+
+    ip->version_ihl = 0x45;
+    ip->tos = 0;
+    ip->length = net_swap16(buffer->length);
+    ip->id = net_swap16(net_ip_id++);
+    ip->fragment = 0;
+    ip->ttl = 64;
+    ip->protocol = protocol;
+    ip->checksum = 0;
+    ip->source = NET_GUEST_IP;
+    ip->destination = destination;
+    ip->checksum = net_checksum(ip, sizeof(*ip));
+
+    if (entry->ip == hop && entry->resolved) {
+        net_eth_send(buffer, entry->mac, ETH_TYPE_IPV4);
+        return;
+    }
+    entry->ip = hop;
+    entry->resolved = 0;
+    if (entry->pending) {
+        net_buffer_put(entry->pending);
+    }
+    entry->pending = buffer;
+    net_arp_send(ARP_REQUEST, net_unknown_mac, hop);
+}
+
+/**
+ * Prepend a UDP header (checksum 0: optional over IPv4) and send.
+ */
+static void net_udp_send(struct net_buffer* buffer, uint32_t destination, uint16_t source_port,
+                         uint16_t destination_port) {
+    struct udp_header* udp = net_buffer_push(buffer, sizeof(*udp));
+
+    udp->source_port = net_swap16(source_port);
+    udp->destination_port = net_swap16(destination_port);
+    udp->length = net_swap16(buffer->length);
+    udp->checksum = 0;
+    net_ipv4_send(buffer, destination, IP_PROTOCOL_UDP);
+}
+
+/**
+ * Learn the sender of any ARP packet aimed at 10.0.2.15 and answer requests.
+ */
+static void net_arp_receive(struct net_buffer* buffer) {
+    struct arp_packet* arp = (struct arp_packet*)buffer->data;
+
+    if (buffer->length < sizeof(*arp) || arp->hardware_type != net_swap16(ARP_HARDWARE_ETHERNET) ||
+        arp->protocol_type != net_swap16(ETH_TYPE_IPV4) || arp->target_ip != NET_GUEST_IP) {
+        return;
+    }
+    net_neighbour_update(arp->sender_ip, arp->sender_mac);
+    if (arp->operation == net_swap16(ARP_REQUEST)) {
+        net_arp_send(ARP_REPLY, arp->sender_mac, arp->sender_ip);
+    }
+}
+
+/**
+ * Handle an IPv4 packet for 10.0.2.15 (fragments are dropped): answer ICMP
+ * echo requests in place, count echo replies and UDP datagrams for
+ * NET_LOCAL_PORT.
+ */
+static void net_ipv4_receive(struct net_buffer* buffer) {
+    struct ipv4_header* ip = (struct ipv4_header*)buffer->data;
+    uint16_t header_size = (ip->version_ihl & 15) * 4;
+    uint16_t length = net_swap16(ip->length);
+
+    if (buffer->length < sizeof(*ip) || (ip->version_ihl >> 4) != 4 ||
+        header_size < sizeof(*ip) || length < header_size || length > buffer->length ||
+        net_checksum(ip, header_size) != 0 || ip->destination != NET_GUEST_IP ||
+        (ip->fragment & net_swap16(IP_FRAGMENT_MASK))) {
+        return;
+    }
+    buffer->length = length; /* Drop the Ethernet padding. */
+    net_buffer_pull(buffer, header_size);
+
+    if (ip->protocol == IP_PROTOCOL_ICMP && buffer->length >= sizeof(struct icmp_echo) &&
+        net_checksum(buffer->data, buffer->length) == 0) {
+        struct icmp_echo* icmp = (struct icmp_echo*)buffer->data;
+
+        if (icmp->type == ICMP_ECHO_REQUEST) {
+            icmp->type = ICMP_ECHO_REPLY;
+            icmp->checksum = 0;
+            icmp->checksum = net_checksum(icmp, buffer->length);
+            buffer->refs++; /* Resent as the reply: net_poll keeps its own reference. */
+            net_ipv4_send(buffer, ip->source, IP_PROTOCOL_ICMP);
+        } else if (icmp->type == ICMP_ECHO_REPLY) {
+            net_echo_replies++;
+        }
+    } else if (ip->protocol == IP_PROTOCOL_UDP && buffer->length >= sizeof(struct udp_header)) {
+        struct udp_header* udp = (struct udp_header*)buffer->data;
+
+        if (udp->destination_port == net_swap16(NET_LOCAL_PORT)) {
+            net_udp_received++;
+        }
+    }
+}
+
+/**
+ * Run every frame waiting in the NE2000 receive ring through the stack.
+ * Each lands in a pool buffer the handlers only borrow: one that keeps or
+ * resends it takes a reference of its own first.
+ */
+static void net_poll(void) {
+    struct net_buffer* buffer;
+
+    if (!ne2k_present) {
+        return;
+    }
+    while ((buffer = net_buffer_alloc()) != 0) {
+        struct eth_header* eth = (struct eth_header*)buffer->data;
+
+        buffer->length = ne2k_receive(buffer->data, NET_BUFFER_SIZE - NET_BUFFER_HEADROOM);
+        if (buffer->length == 0) {
+            net_buffer_put(buffer);
+            return;
+        }
+        if (buffer->length >= sizeof(*eth)) {
+            net_buffer_pull(buffer, sizeof(*eth));
+            if (eth->type == net_swap16(ETH_TYPE_ARP)) {
+                net_arp_receive(buffer);
+            } else if (eth->type == net_swap16(ETH_TYPE_IPV4)) {
+                net_ipv4_receive(buffer);
+            }
+        }
+        net_buffer_put(buffer);
+    }
+}
+
+/**
+ * Poll the card until `*counter` moves off `seen` (a reply arrived) or
+ * NET_TIMEOUT_TICKS pass. Returns nonzero if it moved.
+ */
+static int net_wait(const uint32_t* counter, uint32_t seen) {
+    uint32_t started = bios_ticks();
+
+    while (bios_ticks() - started < NET_TIMEOUT_TICKS) {
+        net_poll();
+        if (*counter != seen) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Make sure the ARP cache holds `ip`, asking for it if needed. Returns its
+ * slot, or 0 if nobody answered within NET_TIMEOUT_TICKS.
+ */
+static struct neighbour* net_resolve(uint32_t ip) {
+    struct neighbour* entry = net_neighbour_slot(ip);
+    uint32_t started = bios_ticks();
+
+    if (entry->ip != ip || !entry->resolved) {
+        net_arp_send(ARP_REQUEST, net_unknown_mac, ip);
+    }
+    while (entry->ip != ip || !entry->resolved) {
+        if (bios_ticks() - started >= NET_TIMEOUT_TICKS) {
+            return 0;
+        }
+        net_poll();
+    }
+    return entry;
+}
+
+/* -------------------------------------------------------------------------- */
+/* TSC clock and time page                                                    */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Divide a 64-bit value by a 32-bit one (shift-subtract; no libgcc here).
+ */
+static uint64_t div_u64_u32(uint64_t dividend, uint32_t divisor) {
+    uint64_t quotient = 0;
+    uint64_t remainder = 0;
+    int bit;
+
+    for (bit = 63; bit >= 0; bit--) {
+        remainder = (remainder << 1) | ((dividend >> bit) & 1);
+        if (remainder >= divisor) {
+            remainder -= divisor;
+            quotient |= (uint64_t)1 << bit;
+        }
+    }
+    return quotient;
+}
+
+/**
+ * Count TSC cycles across TIME_CALIBRATION_TICKS BIOS timer ticks and
+ * publish the TSC-to-nanosecond scale in the time page. The clock starts
+ * at 0 when this runs: the BIOS tick count is time of day (SeaBIOS seeds
+ * it from the RTC) and wraps at midnight, so it is not used as the base.
+ */
+static void time_init(void) {
+    uint64_t booted = rdtsc();
+    uint32_t tick = bios_ticks();
+    uint64_t started;
+    uint32_t cycles;
+
+    /* Start on a tick edge so the interval is whole ticks. */
+    while (bios_ticks() == tick) {
+    }
+    started = rdtsc();
+    tick = bios_ticks();
+    while (bios_ticks() - tick < TIME_CALIBRATION_TICKS) {
+    }
+    cycles = (uint32_t)(rdtsc() - started);
+
+    /* Set, not incremented: RAM at TIME_PAGE_BASE holds garbage at boot. */
+    time_page->seq = 1;
+    __asm__ __volatile__("" ::: "memory");
+    time_page->shift = TIME_SHIFT;
+    time_page->mult = (uint32_t)div_u64_u32(
+        ((uint64_t)BIOS_TICK_NS * TIME_CALIBRATION_TICKS) << TIME_SHIFT, cycles);
+    time_page->tsc_khz = (uint32_t)div_u64_u32(
+        (uint64_t)cycles * 1000, TIME_CALIBRATION_TICKS * (BIOS_TICK_NS / 1000));
+    time_page->tsc_base = booted;
+    time_page->ns_base = 0;
+    __asm__ __volatile__("" ::: "memory");
+    time_page->seq = 2;
+}
+
+/**
+ * Nanoseconds since boot, read from the time page the same way a program
+ * does. The cycle delta is scaled in two parts so the products stay within
+ * 64 bits.
+ */
+static uint64_t clock_ns(void) {
+    uint32_t seq;
+    uint64_t ns;
+
+    do {
+        seq = time_page->seq;
+        __asm__ __volatile__("" ::: "memory");
+
+        uint64_t delta = rdtsc() - time_page->tsc_base;
+        uint32_t shift = time_page->shift;
+        uint32_t mult = time_page->mult;
+
+        ns = time_page->ns_base + (delta >> shift) * mult +
+             (((delta & (((uint64_t)1 << shift) - 1)) * mult) >> shift);
+        __asm__ __volatile__("" ::: "memory");
+    } while ((seq & 1) || seq != time_page->seq);
+
+    return ns;
+}
+
+/* -------------------------------------------------------------------------- */
+/* FPU/SSE state                                                              */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Enable x87 + SSE if the CPU has SSE2 and FXSAVE, and install the #NM
+ * handler used by the lazy policy. Leaves `fpu_present` 0 otherwise, in
+ * which case callers must stay on their scalar paths.
+ */
+static void fpu_init(void) {
+    uint32_t regs[4];
+
+    cpuid(1, regs);
+    if ((regs[3] & (CPUID_EDX_FXSR | CPUID_EDX_SSE | CPUID_EDX_SSE2)) !=
+        (CPUID_EDX_FXSR | CPUID_EDX_SSE | CPUID_EDX_SSE2)) {
+        return;
+    }
+
+    write_cr0((read_cr0() & ~(uint32_t)(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+    __asm__ __volatile__("fninit");
+
+    __asm__ __volatile__("cli");
+    ivt_set_vector(FPU_NM_VECTOR, fpu_nm_stub);
+    __asm__ __volatile__("sti");
+    fpu_present = 1;
+    cpu_features |= CPU_FEATURE_SSE2;
+}
+
+/**
+ * #NM handler body (called from `fpu_nm_stub`): the first FPU/SSE
+ * instruction inside a lazy kernel_fpu_begin section lands here. Save the
+ * interrupted state and clear TS; IRET then re-runs the instruction.
+ */
+void fpu_nm_handler(void) {
+    __asm__ __volatile__("clts");
+    __asm__ __volatile__("fxsave %0" : "=m"(*(uint8_t(*)[512])FPU_SAVE_AREA));
+    fpu_saved = 1;
+}
+
+/**
+ * Start a kernel section that may use FPU/SSE registers (not nestable;
+ * only valid when `fpu_present`). Eager: save the state now with FXSAVE.
+ * Lazy: set CR0.TS and save only if the section really touches the unit.
+ */
+static void kernel_fpu_begin(void) {
+    fpu_saved = 0;
+    if (fpu_lazy) {
+        write_cr0(read_cr0() | CR0_TS);
+        return;
+    }
+    fpu_nm_handler();
+}
+
+/**
+ * End a kernel_fpu_begin section, restoring any state it saved.
+ */
+static void kernel_fpu_end(void) {
+    if (fpu_saved) {
+        __asm__ __volatile__("fxrstor %0" : : "m"(*(const uint8_t(*)[512])FPU_SAVE_AREA));
+        fpu_saved = 0;
+    } else {
+        __asm__ __volatile__("clts");
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* CPU features and boot-time code patching                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Record CPUID features the kernel has alternatives for (SSE2 is added by
+ * fpu_init, since it is only usable once enabled).
+ */
+static void cpu_detect(void) {
+    uint32_t regs[4];
+    uint32_t max_leaf;
+
+    cpuid(0, regs);
+    max_leaf = regs[0];
+
+    cpuid(1, regs);
+    if (regs[2] & CPUID_ECX_SSE42) {
+        cpu_features |= CPU_FEATURE_SSE42;
+    }
+    if (regs[2] & CPUID_ECX_POPCNT) {
+        cpu_features |= CPU_FEATURE_POPCNT;
+    }
+
+    if (max_leaf >= 7) {
+        cpuid(7, regs);
+        if (regs[1] & CPUID_EBX7_ERMS) {
+            cpu_features |= CPU_FEATURE_ERMS;
+        }
+        if (regs[1] & CPUID_EBX7_AVX2) {
+            cpu_features |= CPU_FEATURE_AVX2;
+        }
+    }
+}
+
+/**
+ * Patch every `.alternatives` entry whose feature is present: the first six
+ * bytes of the function become `66 E9 rel32` (JMP rel32 under a 16-bit code
+ * segment). The kernel runs with CS = DS = 0, so code is writable in place.
+ */
+static void alternatives_apply(void) {
+    const struct alternative* entry;
+
+    for (entry = __alternatives_start; entry < __alternatives_end; entry++) {
+        uint8_t* site = (uint8_t*)entry->function;
+
+        if (!(cpu_features & entry->feature)) {
+            continue;
+        }
+        site[0] = 0x66;
+        site[1] = 0xE9;
+        *(uint32_t*)(site + 2) = (uint32_t)entry->replacement - ((uint32_t)site + 6);
+        alternatives_applied++;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+/* Video memory type (MTRR)                                                   */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Retype 0xB8000-0xBBFFF (every text page up to 16KB of cells) with the
+ * SDM's MTRR update sequence: interrupts off, caches disabled and flushed,
+ * MTRRs disabled while the fixed range changes, then everything restored,
+ * including the caller's interrupt flag.
+ */
+static void vga_set_memory_type(uint8_t type) {
+    uint32_t cr0 = read_cr0();
+    uint64_t def_type = rdmsr(MSR_MTRR_DEF_TYPE);
+    uint64_t fixed;
+    uint32_t flags;
+
+    __asm__ __volatile__("pushfl\n\tpopl %0\n\tcli" : "=r"(flags) : : "memory");
+    write_cr0((cr0 | CR0_CD) & ~(uint32_t)CR0_NW);
+    __asm__ __volatile__("wbinvd" : : : "memory");
+    wrmsr(MSR_MTRR_DEF_TYPE, def_type & ~(uint64_t)MTRR_DEF_ENABLE);
+
+    fixed = rdmsr(MSR_MTRR_FIX16K_A0000);
+    fixed &= ~((uint64_t)0xFF << MTRR_VGA_TEXT_SHIFT);
+    fixed |= (uint64_t)type << MTRR_VGA_TEXT_SHIFT;
+    wrmsr(MSR_MTRR_FIX16K_A0000, fixed);
+
+    __asm__ __volatile__("wbinvd" : : : "memory");
+    wrmsr(MSR_MTRR_DEF_TYPE, def_type);
+    write_cr0(cr0);
+    __asm__ __volatile__("pushl %0\n\tpopfl" : : "r"(flags) : "memory", "cc");
+
+    vga_write_combining = type == MTRR_TYPE_WC;
+}
+
+/**
+ * Make VGA text memory write-combining. Needs SSE (for SFENCE), fixed-range
+ * MTRRs with the WC type, and MTRRs already enabled by firmware: turning
+ * them on here would impose the default type on all of RAM.
+ */
+static void vga_mtrr_init(void) {
+    uint32_t regs[4];
+    uint32_t def_type;
+
+    cpuid(1, regs);
+    if (!fpu_present || !(regs[3] & CPUID_EDX_MTRR)) {
+        return;
+    }
+    if ((rdmsr(MSR_MTRR_CAP) & (MTRR_CAP_FIXED | MTRR_CAP_WC)) != (MTRR_CAP_FIXED | MTRR_CAP_WC)) {
+        return;
+    }
+    def_type = (uint32_t)rdmsr(MSR_MTRR_DEF_TYPE);
+    if ((def_type & (MTRR_DEF_ENABLE | MTRR_DEF_FIXED_ENABLE)) !=
+        (MTRR_DEF_ENABLE | MTRR_DEF_FIXED_ENABLE)) {
+        return;
+    }
+
+    vga_mtrr_present = 1;
+    vga_set_memory_type(MTRR_TYPE_WC);
+}
+
+/* -------------------------------------------------------------------------- */
+/* Text modes                                                                 */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Switch text mode: BIOS mode 03h (and the ROM 8x8 font, which alone gives
+ * 80x50 on VGA), then for `crtc` modes the clock and cell width under a
+ * sequencer reset, the matching pel panning, and the unlocked CRTC timing
+ * registers.
+ */
+static void vga_set_text_mode(const struct vga_text_mode* mode) {
+    int i;
+
+    bios_video(0x0003, 0);
+    if (mode->font_8x8) {
+        bios_video(0x1112, 0);
+    }
+
+    if (mode->crtc) {
+        outb(VGA_SEQ_INDEX, 0x00);
+        outb(VGA_SEQ_DATA, 0x01);  /* Synchronous reset while the clock changes. */
+        outb(VGA_MISC_WRITE, mode->misc);
+        outb(VGA_SEQ_INDEX, 0x01);
+        outb(VGA_SEQ_DATA, mode->clocking);
+        outb(VGA_SEQ_INDEX, 0x00);
+        outb(VGA_SEQ_DATA, 0x03);
+
+        /* Mode 03h pans its 9-dot cells by 8, which is 0; 8-dot cells need 0. */
+        inb(VGA_INPUT_STATUS);
+        outb(VGA_AC_WRITE, VGA_AC_PEL_PANNING | VGA_AC_PAS);
+        outb(VGA_AC_WRITE, 0x00);
+
+        outb(VGA_CRTC_INDEX, 0x11);
+        outb(VGA_CRTC_DATA, inb(VGA_CRTC_DATA) & ~VGA_CRTC_PROTECT);
+        for (i = 0; i < VGA_CRTC_COUNT; i++) {
+            outb(VGA_CRTC_INDEX, (uint8_t)i);
+            outb(VGA_CRTC_DATA, mode->crtc[i]);
+        }
+    }
+
+    vga_width = mode->width;
+    vga_height = mode->height;
+    clear_screen();
+    console_render();
+}
+
+/* -------------------------------------------------------------------------- */
+/* System calls (INT 80h)                                                     */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * SYS_NOP: return immediately; used to time the entry/exit path alone.
+ */
+static uint32_t sys_nop(uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    (void)arg0;
+    (void)arg1;
+    (void)arg2;
+    return 0;
+}
+
+/**
+ * Print everything the program has queued in the console ring and publish
+ * the new tail.
+ */
+static void console_ring_drain(void) {
+    uint32_t head = console_ring->head;
+    uint32_t tail = console_ring->tail;
+
+    while (tail != head) {
+        put_char((char)console_ring->data[tail & (CONSOLE_RING_SIZE - 1)]);
+        tail++;
+    }
+    console_ring->tail = tail;
+}
+
+/**
+ * SYS_WRITE: print `length` bytes from physical `buffer` to the console.
+ * Text the program queued in the console ring earlier is printed first, so
+ * the two output paths stay in program order.
+ */
+static uint32_t sys_write(uint32_t buffer, uint32_t length, uint32_t arg2) {
+    const char* data = (const char*)buffer;
+    uint32_t i;
+
+    (void)arg2;
+    console_ring_drain();
+    for (i = 0; i < length; i++) {
+        put_char(data[i]);
+    }
+    return length;
+}
+
+/**
+ * SYS_READ_CHAR: block for the next console character, after printing any
+ * prompt still queued in the console ring.
+ */
+static uint32_t sys_read_char(uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    (void)arg0;
+    (void)arg1;
+    (void)arg2;
+    console_ring_drain();
+    return (uint8_t)console_read_char();
+}
+
+/**
+ * SYS_RING_WAIT: the only kernel entry on the ring path. A program calls it
+ * when the ring is full (or to force output out); returns the free space.
+ */
+static uint32_t sys_ring_wait(uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    (void)arg0;
+    (void)arg1;
+    (void)arg2;
+    console_ring_drain();
+    return CONSOLE_RING_SIZE;
+}
+
+/**
+ * Carry out one submission and return its completion result.
+ */
+static uint32_t uring_execute(const struct uring_sqe* sqe) {
+    switch (sqe->opcode) {
+    case URING_OP_NOP:
+        return 0;
+
+    case URING_OP_WRITE:
+        return sys_write(sqe->address, sqe->length, 0);
+
+    case URING_OP_OPEN: {
+        struct ram_file* file = ram_file_find((const char*)sqe->address);
+        return file ? (uint32_t)(file - ram_files) : URING_ERROR;
+    }
+
+    case URING_OP_READ: {
+        struct ram_file* file;
+        uint32_t length = sqe->length;
+
+        if (sqe->file >= ram_file_count) {
+            return URING_ERROR;
+        }
+        file = &ram_files[sqe->file];
+        if (sqe->offset >= file->size) {
+            return 0;
+        }
+        if (length > file->size - sqe->offset) {
+            length = file->size - sqe->offset;
+        }
+        memcpy((void*)sqe->address, (const void*)(file->address + sqe->offset), length);
+        return length;
+    }
+
+    case URING_OP_TIMEOUT: {
+        uint32_t started = bios_ticks();
+
+        console_render();
+        while (bios_ticks() - started < sqe->length) {
+            __asm__ __volatile__("sti\n\thlt");
+        }
+        return 0;
+    }
+    }
+    return URING_ERROR;
+}
+
+/**
+ * SYS_URING_ENTER: run every queued submission in one kernel entry, as long
+ * as the completion ring has room, and return how many were consumed.
+ */
+static uint32_t sys_uring_enter(uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    uint32_t head = uring->sq_head;
+    uint32_t tail = uring->sq_tail;
+    uint32_t completed = uring->cq_tail;
+    uint32_t consumed = 0;
+
+    (void)arg0;
+    (void)arg1;
+    (void)arg2;
+    while (head != tail && completed - uring->cq_head < URING_ENTRIES) {
+        const struct uring_sqe* sqe = &uring->sqes[head & (URING_ENTRIES - 1)];
+        struct uring_cqe* cqe = &uring->cqes[completed & (URING_ENTRIES - 1)];
+
+        cqe->result = uring_execute(sqe);
+        cqe->user_data = sqe->user_data;
+        head++;
+        completed++;
+        consumed++;
+    }
+
+    /* Publish completions before releasing the submission slots. */
+    uring->cq_tail = completed;
+    uring->sq_head = head;
+    return consumed;
+}
+
+/* Dispatch table indexed by syscall number (EAX). */
+static const syscall_handler syscall_table[] = {
+    sys_nop,        /* SYS_NOP */
+    sys_write,      /* SYS_WRITE */
+    sys_read_char,  /* SYS_READ_CHAR */
+    sys_ring_wait,  /* SYS_RING_WAIT */
+    sys_uring_enter, /* SYS_URING_ENTER */
+};
+
+#define SYSCALL_COUNT (sizeof(syscall_table) / sizeof(syscall_table[0]))
+
+/**
+ * C half of the INT 80h entry, called from `syscall_stub` with the saved
+ * register frame. Unknown numbers return 0xFFFFFFFF in EAX.
+ */
+void syscall_dispatch(struct syscall_frame* frame) {
+    if (frame->eax >= SYSCALL_COUNT) {
+        frame->eax = 0xFFFFFFFF;
+        return;
+    }
+    frame->eax = syscall_table[frame->eax](frame->ebx, frame->ecx, frame->edx);
+}
+
+/**
+ * Install the INT 80h vector.
+ */
+static void syscall_init(void) {
+    __asm__ __volatile__("cli");
+    ivt_set_vector(SYSCALL_VECTOR, syscall_stub);
+    __asm__ __volatile__("sti");
+}
+
+/**
+ * Issue a system call from kernel code through the same INT 80h path a
+ * loaded program would use.
+ */
+static uint32_t syscall3(uint32_t number, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+    uint32_t result;
+
+    __asm__ __volatile__("int $0x80"
+                         : "=a"(result)
+                         : "a"(number), "b"(arg0), "c"(arg1), "d"(arg2)
+                         : "memory");
+    return result;
+}
+
+/* -------------------------------------------------------------------------- */
+/* ELF program loader                                                         */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Validate an ELF32 i386 executable held in a RAM file and load its PT_LOAD
+ * segments into the program window. Returns the entry point, or 0 on error
+ * (a message has been printed). The entry point must lie inside one of the
+ * loaded segments, or the shell would call into whatever the window held.
+ *
+ * Only each segment's file bytes are copied; the .bss tail is zeroed. If
+ * the same file is still resident, read-only segments are skipped: its text
+ * is already in place, so a re-run only pays for writable data.
+ */
+static uint32_t elf_load(struct ram_file* file) {
+    const struct elf32_header* header = (const struct elf32_header*)file->address;
+    uint32_t copied = 0;
+    uint32_t reused = 0;
+    int reuse_text = (program_resident == file);
+    int entry_loaded = 0;
+    int i;
+
+    if (file->size < sizeof(*header) || header->magic != ELF_MAGIC ||
+        header->file_class != ELF_CLASS_32 || header->data != ELF_DATA_LSB ||
+        header->type != ELF_TYPE_EXEC || header->machine != ELF_MACHINE_386 ||
+        header->phentsize != sizeof(struct elf32_program_header) ||
+        header->phoff > file->size ||
+        header->phnum * sizeof(struct elf32_program_header) > file->size - header->phoff) {
+        print("exec: not an i386 ELF executable\n");
+        return 0;
+    }
+
+    /* Validate every segment before touching the window. */
+    for (i = 0; i < header->phnum; i++) {
+        const struct elf32_program_header* segment =
+            (const struct elf32_program_header*)(file->address + header->phoff) + i;
+
+        /* Programs without data still get an empty RW header at vaddr 0. */
+        if (segment->type != ELF_PT_LOAD || segment->memsz == 0) {
+            continue;
+        }
+        if (segment->vaddr < PROGRAM_BASE || segment->vaddr > PROGRAM_LIMIT ||
+            segment->memsz > PROGRAM_LIMIT - segment->vaddr ||
+            segment->filesz > segment->memsz || segment->offset > file->size ||
+            segment->filesz > file->size - segment->offset) {
+            print("exec: segment outside program window\n");
+            return 0;
+        }
+        if (header->entry >= segment->vaddr && header->entry - segment->vaddr < segment->memsz) {
+            entry_loaded = 1;
+        }
+    }
+    if (!entry_loaded) {
+        print("exec: entry point outside loaded segments\n");
+        return 0;
+    }
+
+    program_resident = 0;
+
+    for (i = 0; i < header->phnum; i++) {
+        const struct elf32_program_header* segment =
+            (const struct elf32_program_header*)(file->address + header->phoff) + i;
+
+        /* Programs without data still get an empty RW header at vaddr 0. */
+        if (segment->type != ELF_PT_LOAD || segment->memsz == 0) {
+            continue;
+        }
+        if (reuse_text && !(segment->flags & ELF_PF_W)) {
+            reused += segment->memsz;
+            continue;
+        }
+
+        memcpy((void*)segment->vaddr, (const void*)(file->address + segment->offset),
+               segment->filesz);
+        memset((void*)(segment->vaddr + segment->filesz), 0, segment->memsz - segment->filesz);
+        copied += segment->memsz;
+    }
+
+    program_resident = file;
+
+    print("exec: loaded ");
+    print_uint(copied);
+    print(" bytes, reused ");
+    print_uint(reused);
+    print(" bytes of resident text\n");
+    return header->entry;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Shell commands                                                             */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Print available shell commands.
+ */
+static void command_help(void) {
+    print("Available commands:\n");
+    print("  help  - Show available commands\n");
+    print("  about - Show OS description, features, and purpose\n");
+    print("  clear - Clear the screen\n");
+    print("  ls    - List files held in RAM\n");
+    print("  cat <name>  - Print a RAM file\n");
+    print("  recv <name> - Receive a file over COM1 (tools/sendfile.py)\n");
+    print("  exec <name> - Run an ELF program from a RAM file\n");
+    print("  sysbench    - Time the INT 80h system call round trip\n");
+    print("  uptime      - Show time since boot from the TSC clock\n");
+    print("  fpubench    - Compare eager and lazy FPU/SSE state saving\n");
+    print("  cpu         - Show CPU features and patched-in routines\n");
+    print("  bench       - Time screen redraws uncached vs write-combining\n");
+    print("  mode <WxH>  - Switch text mode: 80x25, 80x50, 90x60\n");
+    print("  net         - Resolve and ping the QEMU gateway (NE2000)\n");
+    print("  udpbench    - UDP packets/s against tools/udp_echo.py\n");
+    print("  cmd | wc         - Count lines, words, bytes of cmd output\n");
+    print("  cmd | grep <text> - Show lines of cmd output containing text\n");
+    print("  fwcfg ls         - List QEMU fw_cfg files\n");
+    print("  fwcfg cat <name> - Print a file loaded from fw_cfg\n");
+    print("  exit  - Exit QEMU\n");
+}
+
+/**
+ * Print educational OS description.
+ */
+static void command_about(void) {
+    print("AnnotatOS - Educational Operating System\n");
+    print("Description:\n");
+    print("  A tiny OS that boots from BIOS and runs a text shell.\n");
+    print("Features:\n");
+    print("  - BIOS bootloader that loads a freestanding C kernel\n");
+    print("  - VGA text-mode output\n");
+    print("  - Interrupt-woken, budgeted PS/2 keyboard polling\n");
+    print("  - Serial console on COM1 for headless/remote use\n");
+    print("  - Binary command-trace telemetry on COM2\n");
+    print("  - QEMU fw_cfg DMA file loading into RAM\n");
+    print("  - Windowed, CRC-checked file upload over serial\n");
+    print("  - INT 80h system call table with a register ABI\n");
+    print("  - ELF program loader with resident-text reuse\n");
+    print("  - Shell pipes that pass RAM files by reference\n");
+    print("  - TSC clock page readable by programs without a system call\n");
+    print("  - Write-combining video memory via fixed-range MTRRs\n");
+    print("  - 80x25, 80x50 and 90x60 text modes switchable at run time\n");
+    print("  - Interactive shell with basic commands\n");
+    print("Purpose:\n");
+    print("  Teach core OS-building ideas from scratch in readable code.\n");
+}
+
+/**
+ * List every RAM file with its size.
+ */
+static void command_ls(void) {
+    int i;
+
+    for (i = 0; i < ram_file_count; i++) {
+        print("  ");
+        print(ram_files[i].name);
+        print("  ");
+        print_uint(ram_files[i].size);
+        print(" bytes\n");
+    }
+    if (ram_file_count == 0) {
+        print("No files in RAM\n");
+    }
+}
+
+/**
+ * Print a RAM file as text; bytes outside printable ASCII show as '.'.
+ */
+static void command_cat(const char* name) {
+    struct ram_file* file = ram_file_find(name);
+    uint32_t i;
+
+    if (!file) {
+        print("No such file in RAM: ");
+        print(name);
+        print("\n");
+        return;
+    }
+
+    /* Into a pipe, the file's own bytes are handed over, not copied. */
+    if (pipe_capturing && pipe_write_reference(file->address, file->size)) {
+        return;
+    }
+
+    for (i = 0; i < file->size; i++) {
+        char c = *(const char*)(file->address + i);
+        put_char((c == '\n' || (c >= 0x20 && c <= 0x7E)) ? c : '.');
+    }
+}
+
+/**
+ * Count lines, words, and bytes of pipe input (`cmd | wc`).
+ */
+static void command_wc(void) {
+    uint32_t lines = 0;
+    uint32_t words = 0;
+    uint32_t bytes = 0;
+    int in_word = 0;
+    int c;
+
+    while ((c = pipe_read_char()) >= 0) {
+        bytes++;
+        if (c == '\n') {
+            lines++;
+        }
+        if (c == ' ' || c == '\n' || c == '\t') {
+            in_word = 0;
+        } else if (!in_word) {
+            in_word = 1;
+            words++;
+        }
+    }
+
+    print_uint(lines);
+    print(" ");
+    print_uint(words);
+    print(" ");
+    print_uint(bytes);
+    print("\n");
+}
+
+/**
+ * Print the lines of pipe input that contain `pattern` (`cmd | grep text`).
+ * Lines longer than the line buffer are matched in pieces.
+ */
+static void command_grep(const char* pattern) {
+    char line[COMMAND_BUFFER_SIZE * 2];
+    int length = 0;
+    int c;
+
+    if (*pattern == '\0') {
+        print("Usage: <command> | grep <text>\n");
+        return;
+    }
+
+    do {
+        c = pipe_read_char();
+        if (c >= 0 && c != '\n' && length < (int)sizeof(line) - 1) {
+            line[length++] = (char)c;
+            continue;
+        }
+
+        line[length] = '\0';
+        if (length > 0 && str_contains(line, pattern)) {
+            print(line);
+            print("\n");
+        }
+        length = 0;
+        if (c >= 0 && c != '\n') {
+            line[length++] = (char)c;
+        }
+    } while (c >= 0);
+}
+
+/**
+ * Load and run an ELF program; it shares the kernel stack and returns its
+ * exit status like a function (programs use INT 80h for console I/O).
+ */
+static void command_exec(const char* name) {
+    struct ram_file* file = ram_file_find(name);
+    uint32_t entry;
 
-/* Basic fixed-width integer types (no libc available in freestanding kernel). */
-typedef unsigned char uint8_t;
-typedef unsigned short uint16_t;
+    if (!file) {
+        print("No such file in RAM: ");
+        print(name);
+        print("\n");
+        return;
+    }
 
-/* VGA buffer pointer. Each cell = [color:8 bits][ASCII char:8 bits]. */
-static uint16_t* vga_buffer = (uint16_t*)VGA_MEMORY;
+    entry = elf_load(file);
+    if (!entry) {
+        return;
+    }
 
-/* Cursor location in text mode coordinates. */
-static int cursor_x = 0;
-static int cursor_y = 0;
+    console_ring->head = 0;
+    console_ring->tail = 0;
+    memset(uring, 0, sizeof(*uring));
 
-/* -------------------------------------------------------------------------- */
-/* Low-level I/O helpers                                                      */
-/* -------------------------------------------------------------------------- */
+    int status = ((int (*)(void))entry)();
+
+    /* Output still queued in the ring when the program returned. */
+    console_ring_drain();
+
+    print("\nexec: exit status ");
+    print_uint((uint32_t)status);
+    print("\n");
+}
 
 /**
- * Read one byte from an I/O port.
+ * Print time since boot (from the TSC time page) and the calibrated TSC
+ * rate.
  */
-static uint8_t inb(uint16_t port) {
-    uint8_t value;
-    __asm__ __volatile__("inb %1, %0" : "=a"(value) : "Nd"(port));
-    return value;
+static void command_uptime(void) {
+    uint32_t ms = (uint32_t)div_u64_u32(clock_ns(), 1000000);
+    uint32_t fraction = ms % 1000;
+
+    print("up ");
+    print_uint(ms / 1000);
+    print(fraction < 100 ? (fraction < 10 ? ".00" : ".0") : ".");
+    print_uint(fraction);
+    print(" s, TSC ");
+    print_uint(time_page->tsc_khz / 1000);
+    print(" MHz\n");
 }
 
 /**
- * Write one 16-bit word to an I/O port.
+ * Time SYSBENCH_ITERATIONS null system calls and report cycles per round
+ * trip, next to a plain function call through the same table for reference.
  */
-static void outw(uint16_t port, uint16_t value) {
-    __asm__ __volatile__("outw %0, %1" : : "a"(value), "Nd"(port));
+static void command_sysbench(void) {
+    uint64_t started;
+    uint32_t syscall_cycles;
+    uint32_t call_cycles;
+    int i;
+
+    started = rdtsc();
+    for (i = 0; i < SYSBENCH_ITERATIONS; i++) {
+        syscall3(SYS_NOP, 0, 0, 0);
+    }
+    syscall_cycles = (uint32_t)(rdtsc() - started);
+
+    started = rdtsc();
+    for (i = 0; i < SYSBENCH_ITERATIONS; i++) {
+        syscall_table[SYS_NOP](0, 0, 0);
+    }
+    call_cycles = (uint32_t)(rdtsc() - started);
+
+    print("INT 80h round trip:   ");
+    print_uint(syscall_cycles / SYSBENCH_ITERATIONS);
+    print(" cycles\n");
+    print("direct table call:    ");
+    print_uint(call_cycles / SYSBENCH_ITERATIONS);
+    print(" cycles\n");
 }
 
 /**
- * Halt the CPU forever.
- * Used when we want to stop execution safely.
+ * Time kernel_fpu_begin/end pairs under both policies, once for sections
+ * that execute an SSE instruction and once for sections that do not.
  */
-static void halt_forever(void) {
-    while (1) {
-        __asm__ __volatile__("hlt");
+static void command_fpubench(void) {
+    static const char* const labels[4] = {
+        "eager, SSE used:    ", "eager, SSE unused:  ",
+        "lazy, SSE used:     ", "lazy, SSE unused:   ",
+    };
+    int saved_policy = fpu_lazy;
+    int run;
+
+    if (!fpu_present) {
+        print("fpubench: CPU lacks SSE2/FXSR\n");
+        return;
+    }
+
+    for (run = 0; run < 4; run++) {
+        uint64_t started;
+        int i;
+
+        fpu_lazy = run >= 2;
+        started = rdtsc();
+        for (i = 0; i < FPUBENCH_ITERATIONS; i++) {
+            kernel_fpu_begin();
+            if ((run & 1) == 0) {
+                __asm__ __volatile__("pxor %%xmm0, %%xmm0" : : : "xmm0");
+            }
+            kernel_fpu_end();
+        }
+
+        print(labels[run]);
+        print_uint((uint32_t)(rdtsc() - started) / FPUBENCH_ITERATIONS);
+        print(" cycles\n");
     }
+    fpu_lazy = saved_policy;
 }
 
 /**
- * Ask QEMU/Bochs-compatible power management ports to power off the VM.
- * If unsupported, execution falls back to halting forever.
+ * List detected CPU features and how many alternatives were patched in.
  */
-static void qemu_poweroff(void) {
-    outw(0x604, 0x2000);  /* QEMU ACPI poweroff (common on i440fx machine). */
-    outw(0xB004, 0x2000); /* Bochs/older compatibility port. */
-    halt_forever();
-}
+static void command_cpu(void) {
+    static const char* const cpu_feature_names[CPU_FEATURE_COUNT] = {
+        "sse2", "sse4.2", "popcnt", "erms", "avx2",
+    };
+    int i;
 
-/* -------------------------------------------------------------------------- */
-/* Screen output                                                              */
-/* -------------------------------------------------------------------------- */
+    print("features:");
+    for (i = 0; i < CPU_FEATURE_COUNT; i++) {
+        if (cpu_features & (1u << i)) {
+            print(" ");
+            print(cpu_feature_names[i]);
+        }
+    }
+    print("\nalternatives: ");
+    print_uint(alternatives_applied);
+    print(" of ");
+    print_uint(__alternatives_end - __alternatives_start);
+    print(" patched in\n");
+}
 
 /**
- * Scroll the screen up by one row when cursor reaches the bottom.
+ * Time BENCH_FRAMES console_render calls (the real frame path: memcpy_nt
+ * from the shadow, then vga_flush) with video memory uncached and then
+ * write-combining, leaving it write-combining.
  */
-static void scroll_if_needed(void) {
-    if (cursor_y < VGA_HEIGHT) {
+static void command_bench(void) {
+    static const char* const labels[2] = {
+        "uncached:         ", "write-combining:  ",
+    };
+    uint32_t cycles[2];
+    int run;
+
+    if (!vga_mtrr_present) {
+        print("bench: no write-combining MTRRs on this CPU/firmware\n");
         return;
     }
 
-    int row;
-    int col;
+    for (run = 0; run < 2; run++) {
+        uint64_t started;
+        int frame;
+        int i;
 
-    /* Move each row up by one. */
-    for (row = 1; row < VGA_HEIGHT; row++) {
-        for (col = 0; col < VGA_WIDTH; col++) {
-            vga_buffer[(row - 1) * VGA_WIDTH + col] = vga_buffer[row * VGA_WIDTH + col];
+        for (i = 0; i < vga_width * vga_height; i++) {
+            console_shadow[i] = (0x0F << 8) | (uint8_t)('0' + run);
+        }
+        vga_set_memory_type(run ? MTRR_TYPE_WC : MTRR_TYPE_UC);
+        started = rdtsc();
+        for (frame = 0; frame < BENCH_FRAMES; frame++) {
+            console_render();
         }
+        cycles[run] = (uint32_t)(rdtsc() - started) / BENCH_FRAMES;
     }
 
-    /* Clear last row after shifting content upward. */
-    for (col = 0; col < VGA_WIDTH; col++) {
-        vga_buffer[(VGA_HEIGHT - 1) * VGA_WIDTH + col] = (0x0F << 8) | ' ';
+    clear_screen();
+    print("full-screen frame, ");
+    print_uint(BENCH_FRAMES);
+    print(" frames each:\n");
+    for (run = 0; run < 2; run++) {
+        print(labels[run]);
+        print_uint(cycles[run]);
+        print(" cycles\n");
     }
-
-    cursor_y = VGA_HEIGHT - 1;
 }
 
 /**
- * Move to a new line (column 0 of next row), then scroll if needed.
+ * Print a MAC address as six colon-separated hex bytes.
  */
-static void newline(void) {
-    cursor_x = 0;
-    cursor_y++;
-    scroll_if_needed();
+static void print_mac(const uint8_t* mac) {
+    static const char digits[] = "0123456789abcdef";
+    int i;
+
+    for (i = 0; i < 6; i++) {
+        put_char(digits[mac[i] >> 4]);
+        put_char(digits[mac[i] & 15]);
+        put_char(i < 5 ? ':' : '\n');
+    }
 }
 
 /**
- * Print one character at the current cursor position.
+ * Show the NE2000's MAC address, resolve QEMU's user-network gateway
+ * (10.0.2.2) through the ARP cache, and ping it once with ICMP echo.
  */
-static void put_char(char c) {
-    if (c == '\n') {
-        newline();
+static void command_net(void) {
+    struct neighbour* gateway;
+    struct net_buffer* buffer;
+    struct icmp_echo* icmp;
+    uint32_t replies = net_echo_replies;
+    uint64_t started;
+
+    if (!ne2k_present) {
+        print("net: no NE2000 at 0x300 (QEMU: -nic user,model=ne2k_isa)\n");
         return;
     }
+    print("net: NE2000 at 0x300, MAC ");
+    print_mac(ne2k_mac);
 
-    vga_buffer[cursor_y * VGA_WIDTH + cursor_x] = (0x0F << 8) | (uint8_t)c;
-    cursor_x++;
+    /* The waits below are busy loops: show the output so far first. */
+    serial_flush();
+    console_render();
 
-    if (cursor_x >= VGA_WIDTH) {
-        newline();
+    gateway = net_resolve(NET_GATEWAY_IP);
+    if (!gateway) {
+        print("net: no ARP reply from 10.0.2.2\n");
+        return;
     }
-}
+    print("net: 10.0.2.2 is at ");
+    print_mac(gateway->mac);
 
-/**
- * Erase one character from the current line (used for backspace handling).
- */
-static void backspace_char(void) {
-    if (cursor_x == 0) {
+    buffer = net_buffer_alloc();
+    if (!buffer) {
+        print("net: no free packet buffer\n");
         return;
     }
+    icmp = net_buffer_push(buffer, sizeof(*icmp));
+    icmp->type = ICMP_ECHO_REQUEST;
+    icmp->code = 0;
+    icmp->checksum = 0;
+    icmp->id = net_swap16(1);
+    icmp->sequence = net_swap16((uint16_t)replies);
+    icmp->checksum = net_checksum(icmp, sizeof(*icmp));
 
-    cursor_x--;
-    vga_buffer[cursor_y * VGA_WIDTH + cursor_x] = (0x0F << 8) | ' ';
-}
-
-/**
- * Print a null-terminated string to the VGA text console.
- */
-void print(const char* str) {
-    int i = 0;
-    while (str[i]) {
-        put_char(str[i]);
-        i++;
+    serial_flush();
+    console_render();
+    started = rdtsc();
+    net_ipv4_send(buffer, NET_GATEWAY_IP, IP_PROTOCOL_ICMP);
+    if (!net_wait(&net_echo_replies, replies)) {
+        print("net: no echo reply from 10.0.2.2\n");
+        return;
     }
+    print("net: ping 10.0.2.2 ");
+    print_uint((uint32_t)(rdtsc() - started));
+    print(" cycles\n");
 }
 
 /**
- * Clear the entire text screen and reset cursor to top-left corner.
+ * Send NET_BENCH_PACKETS UDP datagrams of NET_BENCH_PAYLOAD bytes to
+ * tools/udp_echo.py on the host (10.0.2.2:NET_BENCH_PORT), polling for
+ * echoes between sends, then report the send rate and the echo count.
  */
-void clear_screen(void) {
+static void command_udpbench(void) {
+    uint32_t echoed = net_udp_received;
+    uint32_t sent = 0;
+    uint64_t started;
+    uint32_t ms;
     int i;
-    for (i = 0; i < VGA_WIDTH * VGA_HEIGHT; i++) {
-        vga_buffer[i] = (0x0F << 8) | ' ';
+
+    if (!ne2k_present) {
+        print("udpbench: no NE2000 at 0x300\n");
+        return;
+    }
+    if (!net_resolve(NET_GATEWAY_IP)) {
+        print("udpbench: no ARP reply from 10.0.2.2\n");
+        return;
     }
-    cursor_x = 0;
-    cursor_y = 0;
-}
 
-/* -------------------------------------------------------------------------- */
-/* String helpers (self-contained replacements for libc).                     */
-/* -------------------------------------------------------------------------- */
+    started = rdtsc();
+    for (i = 0; i < NET_BENCH_PACKETS; i++) {
+        struct net_buffer* buffer = net_buffer_alloc();
 
-/**
- * Compare two strings; return 0 if equal.
- */
-int strcmp(const char* s1, const char* s2) {
-    while (*s1 && (*s1 == *s2)) {
-        s1++;
-        s2++;
+        if (buffer) {
+            memset(net_buffer_push(buffer, NET_BENCH_PAYLOAD), (uint8_t)i, NET_BENCH_PAYLOAD);
+            net_udp_send(buffer, NET_GATEWAY_IP, NET_LOCAL_PORT, NET_BENCH_PORT);
+            sent++;
+        }
+        net_poll();
     }
-    return (int)(*s1) - (int)(*s2);
-}
+    ms = (uint32_t)div_u64_u32(rdtsc() - started, time_page->tsc_khz);
 
-/* -------------------------------------------------------------------------- */
-/* Keyboard input                                                             */
-/* -------------------------------------------------------------------------- */
+    /* Collect stragglers until the echoes stop for NET_TIMEOUT_TICKS. */
+    while (net_wait(&net_udp_received, net_udp_received)) {
+    }
+
+    print_uint(sent);
+    print(" datagrams of ");
+    print_uint(NET_BENCH_PAYLOAD);
+    print(" bytes in ");
+    print_uint(ms);
+    print(" ms: ");
+    print_uint(sent * 1000 / (ms ? ms : 1));
+    print(" packets/s, ");
+    print_uint(net_udp_received - echoed);
+    print(" echoed\n");
+}
 
 /**
- * Translate a Set-1 keyboard scancode (press event) into a lowercase ASCII
- * character. Returns 0 for unsupported keys.
- *
- * This mapping intentionally includes only commonly used characters for this
- * educational shell to keep the code focused and readable.
+ * `mode <WxH>` switches to one of `vga_text_modes`; anything else prints
+ * the choices and the current size.
  */
-static char scancode_to_ascii(uint8_t scancode) {
-    switch (scancode) {
-        case 0x02: return '1'; case 0x03: return '2'; case 0x04: return '3';
-        case 0x05: return '4'; case 0x06: return '5'; case 0x07: return '6';
-        case 0x08: return '7'; case 0x09: return '8'; case 0x0A: return '9';
-        case 0x0B: return '0';
-
-        case 0x10: return 'q'; case 0x11: return 'w'; case 0x12: return 'e';
-        case 0x13: return 'r'; case 0x14: return 't'; case 0x15: return 'y';
-        case 0x16: return 'u'; case 0x17: return 'i'; case 0x18: return 'o';
-        case 0x19: return 'p'; case 0x1E: return 'a'; case 0x1F: return 's';
-        case 0x20: return 'd'; case 0x21: return 'f'; case 0x22: return 'g';
-        case 0x23: return 'h'; case 0x24: return 'j'; case 0x25: return 'k';
-        case 0x26: return 'l'; case 0x2C: return 'z'; case 0x2D: return 'x';
-        case 0x2E: return 'c'; case 0x2F: return 'v'; case 0x30: return 'b';
-        case 0x31: return 'n'; case 0x32: return 'm';
+static void command_mode(const char* args) {
+    int i;
 
-        case 0x39: return ' ';  /* Space bar */
-        case 0x0C: return '-';
-        case 0x0D: return '=';
-        default: return 0;
+    for (i = 0; i < VGA_TEXT_MODE_COUNT; i++) {
+        if (strcmp(args, vga_text_modes[i].name) == 0) {
+            vga_set_text_mode(&vga_text_modes[i]);
+            return;
+        }
     }
+
+    print("Usage: mode 80x25|80x50|90x60 (now ");
+    print_uint(vga_width);
+    print("x");
+    print_uint(vga_height);
+    print(")\n");
 }
 
 /**
- * Block until a key press event is available, then return its scancode.
- *
- * Notes:
- * - Status port bit 0 indicates output buffer full (data ready).
- * - We ignore key-release scancodes (high bit set) and wait for key press.
+ * `fwcfg ls` lists the device directory; `fwcfg cat <name>` prints a file
+ * that was loaded into RAM at boot.
  */
-static uint8_t keyboard_read_keypress_scancode(void) {
-    while (1) {
-        if ((inb(KEYBOARD_STATUS_PORT) & 0x01) == 0) {
-            continue;
-        }
+static void command_fwcfg(const char* args) {
+    if (strcmp(args, "ls") == 0) {
+        int i;
 
-        uint8_t scancode = inb(KEYBOARD_DATA_PORT);
-
-        /* Ignore key release events (0x80..0xFF). */
-        if (scancode & 0x80) {
-            continue;
+        if (!fwcfg_dma_present) {
+            print("fw_cfg DMA interface not available\n");
+            return;
         }
 
-        return scancode;
+        for (i = 0; i < fwcfg_directory_count; i++) {
+            print(ram_file_find(fwcfg_directory[i].name) ? "  * " : "    ");
+            print(fwcfg_directory[i].name);
+            print("  ");
+            print_uint(fwcfg_directory[i].size);
+            print(" bytes\n");
+        }
+        if (fwcfg_directory_total > (uint32_t)fwcfg_directory_count) {
+            print("  ... ");
+            print_uint(fwcfg_directory_total - fwcfg_directory_count);
+            print(" more not cached\n");
+        }
+        print("(* = loaded into RAM)\n");
+        return;
     }
-}
 
-/* -------------------------------------------------------------------------- */
-/* Shell commands                                                             */
-/* -------------------------------------------------------------------------- */
+    if (str_starts_with(args, "cat ")) {
+        command_cat(args + 4);
+        return;
+    }
 
-/**
- * Print available shell commands.
- */
-static void command_help(void) {
-    print("Available commands:\n");
-    print("  help  - Show available commands\n");
-    print("  about - Show OS description, features, and purpose\n");
-    print("  clear - Clear the screen\n");
-    print("  exit  - Exit QEMU\n");
+    print("Usage: fwcfg ls | fwcfg cat <name>\n");
 }
 
 /**
- * Print educational OS description.
+ * If `command` is `name` alone or `name` followed by a space, return a
+ * pointer to the argument text (possibly empty); otherwise return 0.
  */
-static void command_about(void) {
-    print("AnnotatOS - Educational Operating System\n");
-    print("Description:\n");
-    print("  A tiny OS that boots from BIOS and runs a text shell.\n");
-    print("Features:\n");
-    print("  - BIOS bootloader that loads a freestanding C kernel\n");
-    print("  - VGA text-mode output\n");
-    print("  - PS/2 keyboard input polling\n");
-    print("  - Interactive shell with basic commands\n");
-    print("Purpose:\n");
-    print("  Teach core OS-building ideas from scratch in readable code.\n");
+static const char* command_args(const char* command, const char* name) {
+    if (!str_starts_with(command, name)) {
+        return 0;
+    }
+
+    command += strlen(name);
+    if (*command == ' ') {
+        return command + 1;
+    }
+    return *command == '\0' ? command : 0;
 }
 
 /**
  * Execute one shell command line.
  */
 static void shell_execute_command(const char* command) {
+    const char* args;
+
     if (strcmp(command, "help") == 0) {
         command_help();
         return;
@@ -329,8 +4073,84 @@ static void shell_execute_command(const char* command) {
         return;
     }
 
+    if (strcmp(command, "ls") == 0) {
+        command_ls();
+        return;
+    }
+
+    if ((args = command_args(command, "cat")) != 0) {
+        command_cat(args);
+        return;
+    }
+
+    if ((args = command_args(command, "recv")) != 0) {
+        command_recv(args);
+        return;
+    }
+
+    if (strcmp(command, "wc") == 0) {
+        command_wc();
+        return;
+    }
+
+    if ((args = command_args(command, "grep")) != 0) {
+        command_grep(args);
+        return;
+    }
+
+    if ((args = command_args(command, "exec")) != 0) {
+        command_exec(args);
+        return;
+    }
+
+    if (strcmp(command, "uptime") == 0) {
+        command_uptime();
+        return;
+    }
+
+    if (strcmp(command, "sysbench") == 0) {
+        command_sysbench();
+        return;
+    }
+
+    if (strcmp(command, "cpu") == 0) {
+        command_cpu();
+        return;
+    }
+
+    if (strcmp(command, "bench") == 0) {
+        command_bench();
+        return;
+    }
+
+    if (strcmp(command, "fpubench") == 0) {
+        command_fpubench();
+        return;
+    }
+
+    if ((args = command_args(command, "mode")) != 0) {
+        command_mode(args);
+        return;
+    }
+
+    if (strcmp(command, "net") == 0) {
+        command_net();
+        return;
+    }
+
+    if (strcmp(command, "udpbench") == 0) {
+        command_udpbench();
+        return;
+    }
+
+    if ((args = command_args(command, "fwcfg")) != 0) {
+        command_fwcfg(args);
+        return;
+    }
+
     if (strcmp(command, "exit") == 0) {
         print("Exiting QEMU...\n");
+        serial_flush();
         qemu_poweroff();
         return;
     }
@@ -344,6 +4164,47 @@ static void shell_execute_command(const char* command) {
     print("\nType 'help' to list commands.\n");
 }
 
+/**
+ * Execute a command line that may contain one pipe: `cmd1 | cmd2` runs cmd1
+ * with its console output captured in the pipe, then runs cmd2 with the
+ * pipe as its input.
+ */
+static void shell_execute_line(const char* command) {
+    char line[COMMAND_BUFFER_SIZE];
+    char* right = line;
+
+    str_copy(line, command, COMMAND_BUFFER_SIZE);
+    while (*right && *right != '|') {
+        right++;
+    }
+    if (*right == '\0') {
+        shell_execute_command(line);
+        return;
+    }
+
+    /* Split the local copy and trim the spaces around '|'. */
+    char* left_end = right;
+    *right++ = '\0';
+    while (left_end > line && left_end[-1] == ' ') {
+        *--left_end = '\0';
+    }
+    while (*right == ' ') {
+        right++;
+    }
+
+    pipe_reset();
+    pipe_capturing = 1;
+    shell_execute_command(line);
+    pipe_capturing = 0;
+
+    pipe_reading = 1;
+    shell_execute_command(right);
+    if (pipe_overflowed) {
+        print("pipe: output truncated\n");
+    }
+    pipe_reset();
+}
+
 /**
  * Run the interactive keyboard shell forever.
  */
@@ -361,19 +4222,25 @@ void shell_run(void) {
         print("kernel> ");
 
         while (1) {
-            uint8_t scancode = keyboard_read_keypress_scancode();
+            char c = console_read_char();
 
             /* Enter key finalizes the command line. */
-            if (scancode == 0x1C) {
+            if (c == '\n') {
                 put_char('\n');
                 command_buffer[index] = '\0';
-                shell_execute_command(command_buffer);
+
+                uint64_t started = rdtsc();
+                shell_execute_line(command_buffer);
+                uint64_t cycles = rdtsc() - started;
+
+                telemetry_write(TELEMETRY_COMMAND, &cycles, sizeof(cycles),
+                                command_buffer, index);
                 print("\n");
                 break;
             }
 
             /* Backspace deletes one character from both buffer and screen. */
-            if (scancode == 0x0E) {
+            if (c == '\b') {
                 if (index > 0) {
                     index--;
                     command_buffer[index] = '\0';
@@ -382,12 +4249,6 @@ void shell_run(void) {
                 continue;
             }
 
-            /* Translate printable keys. */
-            char c = scancode_to_ascii(scancode);
-            if (c == 0) {
-                continue;
-            }
-
             /* Append char if buffer still has room (reserve space for NUL). */
             if (index < COMMAND_BUFFER_SIZE - 1) {
                 command_buffer[index++] = c;
@@ -419,9 +4280,21 @@ void print_logo(void) {
  * Kernel entry point called from kernel_entry.asm.
  */
 void kernel_main(void) {
+    percpu_init();
+    keyboard_init();
+    serial_init();
+    syscall_init();
+    time_init();
+    cpu_detect();
+    fpu_init();
+    alternatives_apply();
+    vga_mtrr_init();
     clear_screen();
     print_logo();
     print("\nAnnotatOS v1.1 - Interactive Educational Operating System\n");
+    fwcfg_init();
+    fwcfg_load_files();
+    ne2k_init();
     print("Type 'help' to see commands.\n\n");
     shell_run();
 
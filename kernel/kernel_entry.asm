@@ -11,12 +11,21 @@
 ;   3) Falls back to halt loop if `kernel_main` unexpectedly returns.
 ;
 ; Runtime behavior:
-;   - This file is transient trampoline code. After entering C, normal runtime
-;     behavior is implemented in kernel.c.
+;   - Apart from the IRQ stubs below, this file is transient trampoline code.
+;     After entering C, normal runtime behavior is implemented in kernel.c.
+;   - `keyboard_irq_stub` / `serial_irq_stub` are installed by kernel.c as the
+;     IRQ1 / IRQ4 vectors. They do not touch the device: they only mask their
+;     own IRQ and acknowledge the PIC, leaving the data for the C polling loop
+;     to drain.
+;   - `syscall_stub` is the INT 80h system call entry. It saves all registers
+;     in a frame that C (`syscall_dispatch`) reads arguments from and writes
+;     the result into, then IRETs back to the caller.
+;   - `fpu_nm_stub` handles #NM for lazy FPU/SSE state saving in kernel.c.
 ;
 ; Memory behavior and layout:
 ;   - Executes from low memory region loaded at 0x1000.
-;   - Stack base set to 0x9000 (real-mode stack, downward growth).
+;   - Stack base set to 0xC000 (real-mode stack, downward growth through
+;     0xB000..0xBFFF, between the kernel image and the program window).
 ;   - No dynamic memory, heap, or relocation exists at this stage.
 ;
 ; CPU-level implications:
@@ -27,7 +36,8 @@
 ;     execution against partially initialized state.
 ;
 ; Limitations and edge cases:
-;   - No protected mode, GDT/IDT, paging, privilege levels, or ISR framework.
+;   - No protected mode, GDT/IDT, paging, or privilege levels; interrupt
+;     handlers are plain real-mode IVT entries.
 ;   - Stack address is fixed and can collide with future larger kernels if not
 ;     coordinated with linker/load placement.
 ; ==============================================================================
@@ -35,7 +45,17 @@
 [BITS 16]
 
 extern kernel_main
+extern syscall_dispatch
+extern fpu_nm_handler
 global _start
+global keyboard_irq_stub
+global serial_irq_stub
+global syscall_stub
+global fpu_nm_stub
+
+PIC1_COMMAND equ 0x20
+PIC1_DATA    equ 0x21
+PIC_EOI      equ 0x20
 
 _start:
     ; Establish deterministic segment and stack state for C code.
@@ -44,7 +64,7 @@ _start:
     mov ds, ax
     mov es, ax
     mov ss, ax
-    mov sp, 0x9000
+    mov sp, 0xC000
     sti
 
     ; Control passes to high-level kernel logic.
@@ -54,3 +74,72 @@ _start:
     cli
     hlt
     jmp $
+
+; ------------------------------------------------------------------------------
+; IRQ_MASK_STUB name, mask_bit: master-PIC IRQ handler
+; Masks further interrupts on its own line and signals EOI. The pending data
+; stays in the device (i8042 output buffer / UART FIFO); kernel.c drains it and
+; re-arms the IRQ only once the device and any receive ring are empty.
+; Clobbers: nothing (AX saved/restored)
+; ------------------------------------------------------------------------------
+%macro IRQ_MASK_STUB 2
+%1:
+    push ax
+    in al, PIC1_DATA
+    or al, %2
+    out PIC1_DATA, al
+    mov al, PIC_EOI
+    out PIC1_COMMAND, al
+    pop ax
+    iret
+%endmacro
+
+IRQ_MASK_STUB keyboard_irq_stub, 0x02   ; IRQ1 (INT 09h)
+IRQ_MASK_STUB serial_irq_stub, 0x10     ; IRQ4 (INT 0Ch), COM1
+
+; ------------------------------------------------------------------------------
+; syscall_stub: INT 80h system call entry
+; ABI: EAX = syscall number, EBX/ECX/EDX = arguments, result returned in EAX.
+; PUSHAD lays out struct syscall_frame (EDI first, EAX last); C updates the
+; saved EAX in place and POPAD hands it back. DS/ES are forced to 0 for C.
+; The C side is compiled with -m16 (32-bit call/ret), hence `o32 call`.
+; ------------------------------------------------------------------------------
+syscall_stub:
+    pushad
+    push ds
+    push es
+    xor ax, ax
+    mov ds, ax
+    mov es, ax
+
+    movzx eax, sp
+    add eax, 4                  ; Skip saved ES/DS: EAX -> PUSHAD frame.
+    push eax
+    o32 call syscall_dispatch
+    add sp, 4
+
+    pop es
+    pop ds
+    popad
+    iret
+
+; ------------------------------------------------------------------------------
+; fpu_nm_stub: #NM (INT 07h) device-not-available fault
+; Raised by the first FPU/SSE instruction after kernel.c set CR0.TS for a lazy
+; kernel_fpu_begin section. C saves the FPU state and clears TS; the IRET
+; returns to the faulting instruction, which then runs normally.
+; ------------------------------------------------------------------------------
+fpu_nm_stub:
+    pushad
+    push ds
+    push es
+    xor ax, ax
+    mov ds, ax
+    mov es, ax
+
+    o32 call fpu_nm_handler
+
+    pop es
+    pop ds
+    popad
+    iret
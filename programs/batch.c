@@ -0,0 +1,154 @@
+/**
+ * SYSTEM-LEVEL OVERVIEW
+ *
+ * Sample AnnotatOS program that batches system calls through the kernel's
+ * shared submission/completion rings (io_uring style). Run it with
+ * `exec opt/bin/batch`.
+ *
+ * Runtime behavior:
+ * 1) Queue two console writes, a RAM file lookup, and a one-tick timeout,
+ *    then run all four with a single SYS_URING_ENTER.
+ * 2) Use the file index from the lookup's completion to queue a read of the
+ *    program's own ELF header and check its magic bytes.
+ *
+ * Memory behavior:
+ * - The rings live at a fixed physical address shared with the kernel;
+ *   `exec` empties them before each run.
+ */
+
+/* System call number, ring layout, and opcodes; must match kernel.c. */
+#define SYS_WRITE 1
+#define SYS_URING_ENTER 4
+#define URING_BASE 0x93000
+#define URING_ENTRIES 16
+#define URING_ERROR 0xFFFFFFFF
+#define URING_OP_WRITE 1
+#define URING_OP_OPEN 2
+#define URING_OP_READ 3
+#define URING_OP_TIMEOUT 4
+
+struct uring_sqe {
+    unsigned char opcode;
+    unsigned char reserved;
+    unsigned short file;
+    unsigned int offset;
+    unsigned int address;
+    unsigned int length;
+    unsigned int user_data;
+};
+
+struct uring_cqe {
+    unsigned int user_data;
+    unsigned int result;
+};
+
+struct uring {
+    volatile unsigned int sq_head;
+    unsigned char sq_head_pad[60];
+    volatile unsigned int sq_tail;
+    unsigned char sq_tail_pad[60];
+    volatile unsigned int cq_head;
+    unsigned char cq_head_pad[60];
+    volatile unsigned int cq_tail;
+    unsigned char cq_tail_pad[60];
+    struct uring_sqe sqes[URING_ENTRIES];
+    struct uring_cqe cqes[URING_ENTRIES];
+};
+
+static struct uring* const uring = (struct uring*)URING_BASE;
+
+static const char first[] = "batch: two writes, an open, and a timeout";
+static const char second[] = " in one system call\n";
+static const char self_name[] = "opt/bin/batch";
+
+/**
+ * Issue an INT 80h system call with up to three register arguments.
+ */
+static unsigned int syscall3(unsigned int number, unsigned int arg0,
+                             unsigned int arg1, unsigned int arg2) {
+    unsigned int result;
+
+    __asm__ __volatile__("int $0x80"
+                         : "=a"(result)
+                         : "a"(number), "b"(arg0), "c"(arg1), "d"(arg2)
+                         : "memory");
+    return result;
+}
+
+/**
+ * Write a null-terminated string to the console.
+ */
+static void print(const char* str) {
+    unsigned int length = 0;
+
+    while (str[length]) {
+        length++;
+    }
+    syscall3(SYS_WRITE, (unsigned int)str, length, 0);
+}
+
+/**
+ * Queue one submission; the kernel sees it on the next SYS_URING_ENTER.
+ */
+static void submit(unsigned char opcode, unsigned short file, unsigned int offset,
+                   const void* address, unsigned int length, unsigned int user_data) {
+    struct uring_sqe* sqe = &uring->sqes[uring->sq_tail & (URING_ENTRIES - 1)];
+
+    sqe->opcode = opcode;
+    sqe->file = file;
+    sqe->offset = offset;
+    sqe->address = (unsigned int)address;
+    sqe->length = length;
+    sqe->user_data = user_data;
+    __asm__ __volatile__("" ::: "memory");
+    uring->sq_tail++;
+}
+
+/**
+ * Pop completions until the one tagged `user_data` is found; returns its
+ * result (URING_ERROR if it is not in the ring).
+ */
+static unsigned int reap(unsigned int user_data) {
+    unsigned int result = URING_ERROR;
+
+    while (uring->cq_head != uring->cq_tail) {
+        struct uring_cqe* cqe = &uring->cqes[uring->cq_head & (URING_ENTRIES - 1)];
+
+        if (cqe->user_data == user_data) {
+            result = cqe->result;
+        }
+        uring->cq_head++;
+    }
+    return result;
+}
+
+/**
+ * Program entry point (see ENTRY in program.ld).
+ */
+int program_main(void) {
+    unsigned char header[4];
+    unsigned int file;
+
+    submit(URING_OP_WRITE, 0, 0, first, sizeof(first) - 1, 1);
+    submit(URING_OP_WRITE, 0, 0, second, sizeof(second) - 1, 2);
+    submit(URING_OP_OPEN, 0, 0, self_name, 0, 3);
+    submit(URING_OP_TIMEOUT, 0, 0, 0, 1, 4);
+    syscall3(SYS_URING_ENTER, 0, 0, 0);
+
+    file = reap(3);
+    if (file == URING_ERROR) {
+        print("batch: opt/bin/batch is not in RAM\n");
+        return 1;
+    }
+
+    submit(URING_OP_READ, (unsigned short)file, 0, header, sizeof(header), 5);
+    syscall3(SYS_URING_ENTER, 0, 0, 0);
+
+    if (reap(5) != sizeof(header) || header[0] != 0x7F || header[1] != 'E' ||
+        header[2] != 'L' || header[3] != 'F') {
+        print("batch: read of own ELF header failed\n");
+        return 1;
+    }
+    print("batch: read own ELF header through the rings\n");
+    return 0;
+}
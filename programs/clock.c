@@ -0,0 +1,155 @@
+/**
+ * SYSTEM-LEVEL OVERVIEW
+ *
+ * Sample AnnotatOS program that reads the kernel's clock without a system
+ * call. The kernel calibrates the TSC at boot and publishes the conversion
+ * parameters in a time page at a fixed physical address; this program reads
+ * the TSC itself and scales it, vDSO style. Run it with `exec opt/bin/clock`.
+ *
+ * Runtime behavior:
+ * 1) Read the time page under its sequence counter and convert the TSC to
+ *    nanoseconds since boot.
+ * 2) Time CLOCK_READS back-to-back clock reads and report cycles per read.
+ * 3) Print through the SYS_WRITE system call.
+ *
+ * Memory behavior:
+ * - The time page is written only by the kernel (once, at boot); nothing
+ *   enforces read-only access in real mode.
+ */
+
+/* System call number and time page layout; must match kernel.c. */
+#define SYS_WRITE 1
+#define TIME_PAGE_BASE 0x92000
+
+/* Reads timed for the cycles-per-read figure. */
+#define CLOCK_READS 1000
+
+struct time_page {
+    volatile unsigned int seq;
+    unsigned int mult;
+    unsigned int shift;
+    unsigned int tsc_khz;
+    unsigned long long tsc_base;
+    unsigned long long ns_base;
+};
+
+static struct time_page* const time_page = (struct time_page*)TIME_PAGE_BASE;
+
+/**
+ * Issue an INT 80h system call with up to three register arguments.
+ */
+static unsigned int syscall3(unsigned int number, unsigned int arg0,
+                             unsigned int arg1, unsigned int arg2) {
+    unsigned int result;
+
+    __asm__ __volatile__("int $0x80"
+                         : "=a"(result)
+                         : "a"(number), "b"(arg0), "c"(arg1), "d"(arg2)
+                         : "memory");
+    return result;
+}
+
+/**
+ * Read the CPU timestamp counter.
+ */
+static unsigned long long rdtsc(void) {
+    unsigned long long value;
+
+    __asm__ __volatile__("rdtsc" : "=A"(value));
+    return value;
+}
+
+/**
+ * Nanoseconds since boot; retries while the kernel is updating the page
+ * (odd or changed `seq`).
+ */
+static unsigned long long clock_ns(void) {
+    unsigned int seq;
+    unsigned long long ns;
+
+    do {
+        seq = time_page->seq;
+        __asm__ __volatile__("" ::: "memory");
+
+        unsigned long long delta = rdtsc() - time_page->tsc_base;
+        unsigned int shift = time_page->shift;
+        unsigned int mult = time_page->mult;
+
+        ns = time_page->ns_base + (delta >> shift) * mult +
+             (((delta & ((1ULL << shift) - 1)) * mult) >> shift);
+        __asm__ __volatile__("" ::: "memory");
+    } while ((seq & 1) || seq != time_page->seq);
+
+    return ns;
+}
+
+/**
+ * Divide a 64-bit value by a 32-bit one (shift-subtract; no libgcc here).
+ */
+static unsigned long long div_u64_u32(unsigned long long dividend, unsigned int divisor) {
+    unsigned long long quotient = 0;
+    unsigned long long remainder = 0;
+    int bit;
+
+    for (bit = 63; bit >= 0; bit--) {
+        remainder = (remainder << 1) | ((dividend >> bit) & 1);
+        if (remainder >= divisor) {
+            remainder -= divisor;
+            quotient |= 1ULL << bit;
+        }
+    }
+    return quotient;
+}
+
+/**
+ * Write a null-terminated string to the console.
+ */
+static void print(const char* str) {
+    unsigned int length = 0;
+
+    while (str[length]) {
+        length++;
+    }
+    syscall3(SYS_WRITE, (unsigned int)str, length, 0);
+}
+
+/**
+ * Print an unsigned 32-bit value in decimal.
+ */
+static void print_uint(unsigned int value) {
+    char digits[11];
+    int count = 10;
+
+    digits[count] = '\0';
+    do {
+        digits[--count] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    print(&digits[count]);
+}
+
+/**
+ * Program entry point (see ENTRY in program.ld).
+ */
+int program_main(void) {
+    unsigned long long started;
+    unsigned int cycles;
+    int i;
+
+    print("clock: ");
+    print_uint((unsigned int)div_u64_u32(clock_ns(), 1000000));
+    print(" ms since boot\n");
+
+    started = rdtsc();
+    for (i = 0; i < CLOCK_READS; i++) {
+        clock_ns();
+    }
+    cycles = (unsigned int)(rdtsc() - started);
+
+    print("clock: ");
+    print_uint(cycles / CLOCK_READS);
+    print(" cycles per read (no system call), TSC ");
+    print_uint(time_page->tsc_khz / 1000);
+    print(" MHz\n");
+    return 0;
+}
@@ -0,0 +1,93 @@
+/**
+ * SYSTEM-LEVEL OVERVIEW
+ *
+ * Sample AnnotatOS program for the `exec` builtin. It is compiled with the
+ * kernel's freestanding 16-bit flags, linked by programs/program.ld into an
+ * ELF executable, and handed to the guest through QEMU fw_cfg as
+ * `opt/bin/hello` by the Makefile run targets.
+ *
+ * Runtime behavior:
+ * 1) The kernel loads PT_LOAD segments into the program window and calls
+ *    `program_main` as a plain function.
+ * 2) Console output either goes through INT 80h system calls (register
+ *    ABI: EAX = number, EBX/ECX/EDX = arguments, EAX = result) or is
+ *    appended to the kernel's shared console ring, which needs no system
+ *    call until the ring fills up.
+ * 3) The return value becomes the exit status printed by the shell.
+ *
+ * Memory behavior:
+ * - `run_count` lives in the writable segment, which `exec` reloads on
+ *   every run, so it always starts at 0; the text segment is reused.
+ */
+
+/* System call numbers and console ring layout; must match kernel.c. */
+#define SYS_WRITE 1
+#define SYS_RING_WAIT 3
+#define CONSOLE_RING_BASE 0x90000
+#define CONSOLE_RING_SIZE 4096
+
+struct console_ring {
+    volatile unsigned int head;
+    unsigned char head_pad[60];
+    volatile unsigned int tail;
+    unsigned char tail_pad[60];
+    unsigned char data[CONSOLE_RING_SIZE];
+};
+
+static struct console_ring* const ring = (struct console_ring*)CONSOLE_RING_BASE;
+
+static unsigned int run_count = 0;
+
+/**
+ * Issue an INT 80h system call with up to three register arguments.
+ */
+static unsigned int syscall3(unsigned int number, unsigned int arg0,
+                             unsigned int arg1, unsigned int arg2) {
+    unsigned int result;
+
+    __asm__ __volatile__("int $0x80"
+                         : "=a"(result)
+                         : "a"(number), "b"(arg0), "c"(arg1), "d"(arg2)
+                         : "memory");
+    return result;
+}
+
+/**
+ * Write a null-terminated string to the console.
+ */
+static void print(const char* str) {
+    unsigned int length = 0;
+
+    while (str[length]) {
+        length++;
+    }
+    syscall3(SYS_WRITE, (unsigned int)str, length, 0);
+}
+
+/**
+ * Queue a null-terminated string in the console ring. Only a full ring
+ * enters the kernel, to let it drain.
+ */
+static void ring_print(const char* str) {
+    unsigned int head = ring->head;
+
+    while (*str) {
+        if (head - ring->tail == CONSOLE_RING_SIZE) {
+            ring->head = head;
+            syscall3(SYS_RING_WAIT, 0, 0, 0);
+        }
+        ring->data[head & (CONSOLE_RING_SIZE - 1)] = (unsigned char)*str++;
+        head++;
+    }
+    ring->head = head;
+}
+
+/**
+ * Program entry point (see ENTRY in program.ld).
+ */
+int program_main(void) {
+    run_count++;
+    print("Hello from an ELF program loaded by exec!\n");
+    ring_print("This line went through the shared ring, no system call.\n");
+    return (int)run_count;
+}
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""
+SYSTEM-LEVEL OVERVIEW
+
+Host-side sender for the AnnotatOS `recv <name>` builtin.
+
+Connects to the COM1 telnet endpoint opened by `make run-remote`, types the
+`recv` command into the shell, then streams the file as CRC-checked frames
+with a go-back-N sliding window. Several frames stay in flight, so the
+line is never idle waiting for a per-frame handshake.
+
+Wire format (must match kernel.c):
+    host -> guest  [0x02][type][seq][len][payload ...][crc16 hi][crc16 lo]
+                   type 'S' payload = u32 LE size, 'D' data, 'E' end
+                   crc16 = CRC-16/CCITT-FALSE over type, seq, len, payload
+    guest -> host  [0x02][type][seq & 0x7F]
+                   'R' ready, 'A' cumulative ack, 'N' resend from seq,
+                   'F' failed
+
+Telnet transport: 0xFF bytes sent to the guest are doubled (IAC IAC), and
+the server's option negotiation is stripped from incoming data.
+
+Usage:
+    make run-remote &
+    python3 tools/sendfile.py data.bin [name] [--port 4444] [--window 16]
+"""
+
+import argparse
+import os
+import socket
+import struct
+import sys
+import time
+
+SYNC = 0x02
+PAYLOAD_MAX = 128
+IAC = 0xFF
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def frame(ftype, seq, payload=b""):
+    body = bytes([ord(ftype), seq & 0xFF, len(payload)]) + payload
+    return bytes([SYNC]) + body + struct.pack(">H", crc16_ccitt(body))
+
+
+class Link:
+    """Telnet-aware byte stream over a TCP socket."""
+
+    def __init__(self, sock):
+        self.sock = sock
+        self.pending = bytearray()
+        self.iac_skip = 0
+
+    def send(self, data):
+        self.sock.sendall(data.replace(b"\xff", b"\xff\xff"))
+
+    def _fill(self, timeout):
+        self.sock.settimeout(timeout)
+        try:
+            chunk = self.sock.recv(65536)
+        except socket.timeout:
+            return False
+        if not chunk:
+            sys.exit("connection closed by QEMU")
+        for byte in chunk:
+            if self.iac_skip:
+                self.iac_skip -= 1
+            elif byte == IAC:
+                self.iac_skip = 2
+            else:
+                self.pending.append(byte)
+        return True
+
+    def read_until(self, needle, timeout):
+        """Return text received up to and including `needle`, or None."""
+        deadline = time.monotonic() + timeout
+        while needle not in self.pending:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0 or not self._fill(remaining):
+                return None
+        end = self.pending.index(needle) + len(needle)
+        text = bytes(self.pending[:end])
+        del self.pending[:end]
+        return text
+
+    def read_reply(self, timeout):
+        """Return the next (type, seq7) reply frame, or None on timeout."""
+        deadline = time.monotonic() + timeout
+        while True:
+            if SYNC in self.pending:
+                start = self.pending.index(SYNC)
+                if len(self.pending) >= start + 3:
+                    reply = (chr(self.pending[start + 1]), self.pending[start + 2])
+                    del self.pending[:start + 3]
+                    return reply
+            remaining = deadline - time.monotonic()
+            if remaining <= 0 or not self._fill(remaining):
+                return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Upload a file to AnnotatOS over COM1.")
+    parser.add_argument("path")
+    parser.add_argument("name", nargs="?")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=4444)
+    parser.add_argument("--window", type=int, default=16,
+                        help="frames in flight (1..64)")
+    args = parser.parse_args()
+
+    window = max(1, min(64, args.window))
+    name = args.name or os.path.basename(args.path)
+    with open(args.path, "rb") as f:
+        data = f.read()
+
+    frames = [frame("S", 0, struct.pack("<I", len(data)))]
+    for offset in range(0, len(data), PAYLOAD_MAX):
+        frames.append(frame("D", len(frames), data[offset:offset + PAYLOAD_MAX]))
+    frames.append(frame("E", len(frames)))
+
+    link = Link(socket.create_connection((args.host, args.port)))
+    link.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    link.send(b"\r")
+    if link.read_until(b"kernel> ", 5.0) is None:
+        sys.exit("no shell prompt on %s:%d" % (args.host, args.port))
+    link.send(("recv %s\r" % name).encode("ascii"))
+
+    reply = link.read_reply(5.0)
+    if reply is None or reply[0] != "R":
+        sys.exit("guest did not enter recv mode")
+
+    started = time.monotonic()
+    base = 0
+    sent = 0
+    resends = 0
+    while base < len(frames):
+        burst = b""
+        while sent < len(frames) and sent - base < window:
+            burst += frames[sent]
+            sent += 1
+        if burst:
+            link.send(burst)
+
+        reply = link.read_reply(0.5)
+        if reply is None:
+            resends += sent - base
+            sent = base
+            continue
+
+        kind, seq7 = reply
+        index = base + ((seq7 - base) & 0x7F)
+        if kind == "A" and index < sent:
+            base = index + 1
+        elif kind == "N" and index < sent:
+            resends += sent - index
+            sent = index
+        elif kind == "F":
+            sys.exit("guest rejected the transfer")
+
+    elapsed = time.monotonic() - started
+    summary = link.read_until(b"kernel> ", 5.0) or b""
+    for line in summary.decode("ascii", "replace").splitlines():
+        if line.startswith("recv:"):
+            print("guest: " + line)
+    print("host:  %d bytes in %.2f s (%.0f bytes/s), %d frames resent"
+          % (len(data), elapsed, len(data) / elapsed if elapsed else 0, resends))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+SYSTEM-LEVEL OVERVIEW
+
+Host-side keystroke round-trip probe for the AnnotatOS serial console.
+
+`make run-remote` starts QEMU with COM1 exposed as a telnet server on
+localhost. This script connects to it, types one character at a time and
+measures how long the shell takes to echo it back, then deletes it again with
+DEL so the guest command line stays empty.
+
+Each sample covers: host socket write -> QEMU chardev -> UART RX FIFO -> IRQ4
+wakeup -> shell echo -> UART TX -> QEMU chardev -> host socket read.
+
+Usage:
+    make run-remote &
+    python3 tools/serial_latency.py [--host 127.0.0.1] [--port 4444] [-n 200]
+"""
+
+import argparse
+import socket
+import sys
+import time
+
+IAC = 0xFF
+
+
+def strip_telnet(data):
+    """Drop telnet IAC negotiation triplets that QEMU's server sends."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        if data[i] == IAC:
+            i += 3
+            continue
+        out.append(data[i])
+        i += 1
+    return bytes(out)
+
+
+def read_until(sock, needle, timeout):
+    """Read from sock until `needle` appears; return False on timeout."""
+    deadline = time.monotonic() + timeout
+    buf = b""
+    while needle not in buf:
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            return False
+        sock.settimeout(remaining)
+        try:
+            chunk = sock.recv(4096)
+        except socket.timeout:
+            return False
+        if not chunk:
+            return False
+        buf += strip_telnet(chunk)
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=4444)
+    parser.add_argument("-n", "--samples", type=int, default=200)
+    args = parser.parse_args()
+
+    sock = socket.create_connection((args.host, args.port))
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    # Get a fresh prompt so the guest line buffer is known to be empty.
+    sock.sendall(b"\r")
+    if not read_until(sock, b"kernel> ", 5.0):
+        sys.exit("no shell prompt on %s:%d" % (args.host, args.port))
+
+    samples = []
+    for _ in range(args.samples):
+        start = time.perf_counter()
+        sock.sendall(b"x")
+        if not read_until(sock, b"x", 2.0):
+            sys.exit("timed out waiting for echo")
+        samples.append(time.perf_counter() - start)
+
+        sock.sendall(b"\x7f")
+        if not read_until(sock, b"\b \b", 2.0):
+            sys.exit("timed out waiting for backspace echo")
+
+    samples.sort()
+    us = [s * 1e6 for s in samples]
+    print("keystroke round trip over %d samples (us):" % len(us))
+    print("  min %.1f  median %.1f  p99 %.1f  max %.1f"
+          % (us[0], us[len(us) // 2], us[min(len(us) - 1, len(us) * 99 // 100)], us[-1]))
+
+
+if __name__ == "__main__":
+    main()
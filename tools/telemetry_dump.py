@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""
+SYSTEM-LEVEL OVERVIEW
+
+Decoder for the AnnotatOS COM2 telemetry stream.
+
+The kernel writes framed binary records to COM2; the Makefile run targets
+attach COM2 to a host file (build/telemetry.bin by default). Record layout:
+
+    [0xA5 magic][type u8][payload length u8][payload ...]
+
+Known types:
+    0x01 command: u64 little-endian TSC cycles spent in the command,
+                  followed by the command text.
+
+Unknown types are printed as hex so new record kinds stay visible.
+
+Usage:
+    python3 tools/telemetry_dump.py [build/telemetry.bin]
+"""
+
+import struct
+import sys
+
+MAGIC = 0xA5
+TYPE_COMMAND = 0x01
+
+
+def records(data):
+    """Yield (type, payload) pairs, resynchronising on the magic byte."""
+    i = 0
+    while i + 3 <= len(data):
+        if data[i] != MAGIC:
+            i += 1
+            continue
+        rtype, length = data[i + 1], data[i + 2]
+        payload = data[i + 3:i + 3 + length]
+        if len(payload) < length:
+            break
+        yield rtype, payload
+        i += 3 + length
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else "build/telemetry.bin"
+    with open(path, "rb") as f:
+        data = f.read()
+
+    for rtype, payload in records(data):
+        if rtype == TYPE_COMMAND and len(payload) >= 8:
+            (cycles,) = struct.unpack_from("<Q", payload)
+            text = payload[8:].decode("ascii", "replace")
+            print("command %-24s %12d cycles" % (repr(text), cycles))
+        else:
+            print("type 0x%02x: %s" % (rtype, payload.hex()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""
+SYSTEM-LEVEL OVERVIEW
+
+Host-side UDP echo server for the AnnotatOS `udpbench` builtin.
+
+With QEMU user networking (`-nic user,model=ne2k_isa`), datagrams the guest
+sends to the gateway 10.0.2.2 arrive on the host's loopback interface. This
+script binds there and sends every datagram straight back to its sender;
+`udpbench` counts the echoes it receives while it transmits.
+
+Usage:
+    python3 tools/udp_echo.py [--host 127.0.0.1] [--port 7777] &
+    make run        # then: kernel> udpbench
+"""
+
+import argparse
+import socket
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=7777)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.host, args.port))
+    print("echoing UDP on %s:%d" % (args.host, args.port))
+
+    echoed = 0
+    try:
+        while True:
+            data, sender = sock.recvfrom(2048)
+            sock.sendto(data, sender)
+            echoed += 1
+    except KeyboardInterrupt:
+        print("\n%d datagrams echoed" % echoed)
+
+
+if __name__ == "__main__":
+    main()